@@ -1,6 +1,160 @@
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "src/lexer/batchlexer.h"
+#include "src/lexer/streamlexer.h"
+#include "src/lexer/threadpool.h"
+#include "src/lexer/timetrace.h"
+
+#ifdef VIREO_PERF_COUNTERS
+#include <utility>
+
 #include "src/lexer/lexer.h"
+#include "src/lexer/perfcounters.h"
+#include "src/lexer/sourcebuffer.h"
 
-int main(int argc, char* argv[]) {
-    auto lexer = Lexer::Lexer(argv[1]);
+/**
+ * @brief Lexes the files one after another on this thread, so the hardware counters, which follow one thread, see
+ * all of the work.
+ *
+ * @param inputBytes Increased by the size of every file that was read.
+ *
+ * @returns The exit status: 1 if a file could not be read.
+ */
+static int LexOnThisThread(const std::vector<std::string>& paths, std::size_t& inputBytes) {
+    int status = 0;
+    for (const std::string& path : paths) {
+        try {
+            Lexer::SourceBuffer source = Lexer::SourceBuffer::FromFile(path);
+            inputBytes += source.Text().size();
+            Lexer::Lexer lexer(std::move(source));
+            lexer.Tokenize();
+        } catch (const std::system_error& error) {
+            std::cerr << error.what() << '\n';
+            status = 1;
+        }
+    }
+    return status;
+}
+#endif
+
+/**
+ * @brief Lexes the files in parallel on a pool sized to the machine.
+ *
+ * @returns The exit status: 1 if a file could not be read.
+ */
+static int LexInBatch(const std::vector<std::string>& paths) {
+    Lexer::ThreadPool pool;
+    Lexer::BatchLexer batch(pool);
+
+    std::vector<Lexer::BatchFile> files;
+    {
+        const Lexer::TraceScope span("Lex files");
+        files = batch.LexFiles(paths);
+    }
+
+    int status = 0;
+    for (const Lexer::BatchFile& file : files) {
+        if (!file.error) continue;
+
+        try {
+            std::rethrow_exception(file.error);
+        } catch (const std::system_error& error) {
+            std::cerr << error.what() << '\n';
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/**
+ * @brief Lexes standard input as a stream, so a generator can be piped in without buffering its whole output.
+ *
+ * @param inputBytes Increased by the number of bytes read.
+ *
+ * @returns The exit status: 1 if standard input could not be read.
+ */
+static int LexStandardInput(std::size_t& inputBytes) {
+    try {
+        const Lexer::TraceScope span("Lex", "<stdin>");
+        Lexer::StreamLexer stream(0);
+        Lexer::Token token = stream.NextToken();
+        while (token.type != Lexer::TokenType::END_OF_FILE) token = stream.NextToken();
+        inputBytes += token.offset;
+    } catch (const std::system_error& error) {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> paths;
+    std::string tracePath; // Set by -ftime-trace[=file].
+    bool perfCounters = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (argument == "-ftime-trace") tracePath = "vireo-time-trace.json";
+        else if (argument.starts_with("-ftime-trace=")) tracePath = argument.substr(std::string_view("-ftime-trace=").size());
+        else if (argument == "--perf-counters") perfCounters = true;
+        else paths.emplace_back(argument);
+    }
+
+#ifndef VIREO_PERF_COUNTERS
+    if (perfCounters) {
+        std::cerr << argv[0] << ": --perf-counters needs a build with VIREO_PERF_COUNTERS defined\n";
+        return 1;
+    }
+#endif
+
+    // "-" reads standard input as a stream.
+    const auto standardInput = std::remove(paths.begin(), paths.end(), "-");
+    const bool readStandardInput = standardInput != paths.end();
+    paths.erase(standardInput, paths.end());
+
+    if (paths.empty() && !readStandardInput) {
+        std::cerr << "Usage: " << argv[0] << " [-ftime-trace[=file]] [--perf-counters] <source file | ->...\n";
+        return 1;
+    }
+
+    std::optional<Lexer::TimeTrace> trace;
+    if (!tracePath.empty()) trace.emplace();
+
+    int status = 0;
+    std::size_t inputBytes = 0;
+#ifdef VIREO_PERF_COUNTERS
+    std::optional<Lexer::PerfCounters> counters;
+    if (perfCounters) {
+        counters.emplace();
+        status = LexOnThisThread(paths, inputBytes);
+    } else {
+        status = LexInBatch(paths);
+    }
+#else
+    status = LexInBatch(paths);
+#endif
+
+    if (readStandardInput) status |= LexStandardInput(inputBytes);
+
+#ifdef VIREO_PERF_COUNTERS
+    if (counters) counters->Report(std::cerr, inputBytes);
+#endif
+
+    if (trace) {
+        try {
+            trace->WriteFile(tracePath);
+        } catch (const std::system_error& error) {
+            std::cerr << error.what() << '\n';
+            status = 1;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,89 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace Lexer {
+    /**
+     * @brief Creates an empty arena. No memory is taken until the first allocation.
+     *
+     * @param blockSize The size of each block requested from the heap. Larger allocations get a block of their own.
+     */
+    Arena::Arena(const std::size_t blockSize) : blockSize(blockSize) {}
+
+    /**
+     * @brief Allocates memory that lives until the arena is released or destroyed.
+     *
+     * @param size The number of bytes to allocate.
+     * @param alignment The required alignment, a power of two.
+     *
+     * @returns Uninitialized memory of at least size bytes.
+     */
+    void* Arena::Allocate(const std::size_t size, const std::size_t alignment) {
+        const std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(cursor) % alignment) % alignment;
+
+        if (cursor == nullptr || padding + size > remaining) {
+            const std::size_t capacity = std::max(blockSize, size + alignment);
+            std::byte* block = blocks.emplace_back(std::make_unique_for_overwrite<std::byte[]>(capacity)).get();
+            cursor = block;
+            remaining = capacity;
+            reserved += capacity;
+            return Allocate(size, alignment);
+        }
+
+        std::byte* allocation = cursor + padding;
+        cursor = allocation + size;
+        remaining -= padding + size;
+        return allocation;
+    }
+
+    /**
+     * @brief Copies text into the arena.
+     *
+     * @param text The text to copy.
+     *
+     * @returns A view of the copy, valid until the arena is released or destroyed.
+     */
+    std::string_view Arena::Store(const std::string_view text) {
+        if (text.empty()) return {};
+
+        auto* copy = static_cast<char*>(Allocate(text.size(), 1));
+        std::memcpy(copy, text.data(), text.size());
+        return {copy, text.size()};
+    }
+
+    /**
+     * @brief Frees every allocation at once. The cost depends on the number of blocks, not the number of allocations.
+     */
+    void Arena::Release() {
+        blocks.clear();
+        cursor = nullptr;
+        remaining = 0;
+        reserved = 0;
+    }
+
+    /**
+     * @brief Frees every allocation at once but keeps the current block, so an arena reused for similar work stops
+     * going to the heap after its first round.
+     */
+    void Arena::Rewind() {
+        if (blocks.empty()) return;
+
+        std::byte* block = blocks.back().get();
+        const std::size_t capacity = static_cast<std::size_t>(cursor - block) + remaining;
+        if (blocks.size() > 1) {
+            blocks.front() = std::move(blocks.back());
+            blocks.resize(1);
+        }
+        cursor = block;
+        remaining = capacity;
+        reserved = capacity;
+    }
+
+    /**
+     * @returns The total size of the blocks taken from the heap, whether handed out yet or not.
+     */
+    std::size_t Arena::BytesReserved() const {
+        return reserved;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace Lexer {
+    /**
+     * @brief A bump allocator. Allocations are carved out of large blocks and are only ever freed all at once.
+     *
+     * It is also a std::pmr::memory_resource, so pmr containers such as a token vector can be placed in it. Deallocation is
+     * a no-op; everything goes in one Release, without visiting individual allocations.
+     */
+    class Arena : public std::pmr::memory_resource {
+    private:
+        static constexpr std::size_t defaultBlockSize = 64 * 1024;
+
+        std::vector<std::unique_ptr<std::byte[]>> blocks;
+        std::byte* cursor = nullptr;
+        std::size_t remaining = 0;
+        std::size_t reserved = 0;
+        std::size_t blockSize;
+    public:
+        explicit Arena(std::size_t blockSize = defaultBlockSize);
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        Arena(Arena&&) noexcept = default;
+        Arena& operator=(Arena&&) noexcept = default;
+
+        void* Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+        std::string_view Store(std::string_view text);
+        void Release();
+        void Rewind();
+        std::size_t BytesReserved() const;
+    private:
+        void* do_allocate(std::size_t size, std::size_t alignment) override { return Allocate(size, alignment); }
+        void do_deallocate(void*, std::size_t, std::size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+}
+
+#endif //ARENA_H
@@ -0,0 +1,115 @@
+#include "batchlexer.h"
+#include <algorithm>
+#include <filesystem>
+#include <future>
+#include <system_error>
+#include <utility>
+
+#include "lexer.h"
+#include "timetrace.h"
+
+namespace Lexer {
+    /**
+     * @brief Creates a batch lexer that runs on the given pool.
+     *
+     * @param pool The threads to lex on. A pool sized to the machine, the default, is usually right.
+     * @param splitSize Files of at least this many bytes are themselves lexed in parallel chunks.
+     */
+    BatchLexer::BatchLexer(ThreadPool& pool, const std::size_t splitSize) : pool(pool), splitSize(splitSize) {}
+
+    /**
+     * @brief Loads and lexes source files.
+     *
+     * @param paths The files to lex.
+     *
+     * @returns One result per path, in the same order. A file that cannot be read has its error set instead of tokens.
+     */
+    std::vector<BatchFile> BatchLexer::LexFiles(const std::vector<std::string>& paths) {
+        std::vector<Job> jobs;
+        jobs.reserve(paths.size());
+        for (std::size_t i = 0; i < paths.size(); i++) {
+            // Only used for ordering. An unreadable file sorts last and reports its error when it is loaded.
+            std::error_code error;
+            const std::uintmax_t size = std::filesystem::file_size(paths[i], error);
+            jobs.push_back({i, error ? 0 : static_cast<std::size_t>(size), paths[i], {}});
+        }
+        return Run(std::move(jobs));
+    }
+
+    /**
+     * @brief Lexes source code that is already in memory.
+     *
+     * @param buffers The source code to lex. It is viewed, not copied, so it must outlive the results.
+     *
+     * @returns One result per buffer, in the same order.
+     */
+    std::vector<BatchFile> BatchLexer::LexBuffers(const std::vector<std::string_view>& buffers) {
+        std::vector<Job> jobs;
+        jobs.reserve(buffers.size());
+        for (std::size_t i = 0; i < buffers.size(); i++) {
+            jobs.push_back({i, buffers[i].size(), {}, buffers[i]});
+        }
+        return Run(std::move(jobs));
+    }
+
+    /**
+     * @brief Submits the jobs largest first and waits for all of them.
+     *
+     * @param jobs What to lex, with the size of each for scheduling.
+     *
+     * @returns The results, in the order of the jobs' indices.
+     */
+    std::vector<BatchFile> BatchLexer::Run(std::vector<Job> jobs) {
+        std::vector<BatchFile> files(jobs.size());
+
+        std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.size > b.size; });
+
+        std::vector<std::future<void>> lexed;
+        lexed.reserve(jobs.size());
+        for (Job& job : jobs) {
+            lexed.push_back(pool.Submit([this, &file = files[job.index], job = std::move(job)] {
+                try {
+                    const TraceScope span("Load", job.path);
+                    file.source = std::make_unique<SourceBuffer>(job.path.empty() ? SourceBuffer::View(job.text)
+                                                                                  : SourceBuffer::FromFile(job.path));
+                } catch (const std::system_error&) {
+                    file.error = std::current_exception();
+                    return;
+                }
+
+                const TraceScope span("Lex", job.path);
+                Lex(file);
+            }));
+        }
+
+        // Every task writes into files, so all of them must finish before a failure can unwind past it.
+        pool.WaitAll(lexed);
+        return files;
+    }
+
+    /**
+     * @brief Lexes one loaded file into its token stream, splitting it into chunks if it is large.
+     *
+     * @param file The file to lex. Its source must be set.
+     */
+    void BatchLexer::Lex(BatchFile& file) const {
+        const std::string_view text = file.source->Text();
+
+        if (text.size() < splitSize || pool.Size() == 1) {
+            Lexer lexer(SourceBuffer::View(text));
+            file.tokens = lexer.TokenizeStream();
+            file.diagnostics = lexer.Diagnostics();
+            return;
+        }
+
+        ParallelLexer lexer(SourceBuffer::View(text), splitSize / 2);
+        const std::vector<Token> tokens = lexer.Tokenize(pool);
+
+        file.tokens = TokenStream(text);
+        file.tokens.Reserve(tokens.size());
+        for (const Token& token : tokens) {
+            file.tokens.Append(token);
+        }
+        file.diagnostics = lexer.Diagnostics();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef BATCHLEXER_H
+#define BATCHLEXER_H
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "diagnostic.h"
+#include "parallellexer.h"
+#include "sourcebuffer.h"
+#include "threadpool.h"
+#include "tokenstream.h"
+
+namespace Lexer {
+    /**
+     * @brief The result of lexing one file of a batch.
+     */
+    struct BatchFile {
+        std::unique_ptr<SourceBuffer> source; // On the heap so the tokens' view of it survives moving the result.
+        TokenStream tokens;
+        std::vector<Diagnostic> diagnostics;
+        std::exception_ptr error; // Set, and tokens left empty, if the file could not be read.
+    };
+
+    /**
+     * @brief Lexes many files or buffers at once on a thread pool.
+     *
+     * Work is submitted largest first, so the big files start early and the small ones fill in the gaps at the end.
+     * A file larger than the split size is lexed by a ParallelLexer on the same pool, so one huge file is spread over
+     * every worker instead of holding up the batch on its own.
+     */
+    class BatchLexer {
+    private:
+        struct Job {
+            std::size_t index;
+            std::size_t size;
+            std::string path; // Empty for a buffer.
+            std::string_view text;
+        };
+
+        ThreadPool& pool;
+        std::size_t splitSize;
+
+        std::vector<BatchFile> Run(std::vector<Job> jobs);
+        void Lex(BatchFile& file) const;
+    public:
+        static constexpr std::size_t defaultSplitSize = 2 * ParallelLexer::defaultChunkSize;
+
+        explicit BatchLexer(ThreadPool& pool, std::size_t splitSize = defaultSplitSize);
+
+        std::vector<BatchFile> LexFiles(const std::vector<std::string>& paths);
+        std::vector<BatchFile> LexBuffers(const std::vector<std::string_view>& buffers);
+    };
+}
+
+#endif //BATCHLEXER_H
@@ -0,0 +1,510 @@
+#include "charscan.h"
+#include <atomic>
+#include <cstdint>
+
+#include "unicode.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define VIREO_HAS_X86_SIMD 1
+#endif
+
+namespace Lexer {
+    namespace {
+        void FindLineStartsScalar(const std::string_view text, std::size_t position, std::vector<std::uint32_t>& lineStarts) {
+            for (; position < text.size(); position++) {
+                if (text[position] == '\n') lineStarts.push_back(static_cast<std::uint32_t>(position + 1));
+            }
+        }
+
+#if VIREO_HAS_X86_SIMD
+        // Each block is classified into a bitmask with one bit per byte. The run ends at the first clear bit; if every
+        // bit is set the whole block belongs to the run and the next block is examined. Bytes of 0x80 and above are
+        // negative as signed chars, so they fall outside every range check below.
+
+        /**
+         * @brief Records a line start after every newline flagged in a block's bitmask.
+         */
+        void AppendLineStarts(std::uint32_t newlineMask, const std::size_t blockStart, std::vector<std::uint32_t>& lineStarts) {
+            while (newlineMask != 0) {
+                lineStarts.push_back(static_cast<std::uint32_t>(blockStart + __builtin_ctz(newlineMask) + 1));
+                newlineMask &= newlineMask - 1;
+            }
+        }
+
+        __m128i InRange128(const __m128i bytes, const char low, const char high) {
+            return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(low - 1))),
+                                 _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(high + 1))));
+        }
+
+        std::uint32_t WhitespaceMask128(const __m128i bytes) {
+            const __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                                                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')));
+            const __m128i breaks = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')),
+                                                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(spaces, breaks)));
+        }
+
+        std::uint32_t IdentifierMask128(const __m128i bytes) {
+            const __m128i lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20)); // Folds 'A'-'Z' onto 'a'-'z'.
+            const __m128i letters = InRange128(lower, 'a', 'z');
+            const __m128i digits = InRange128(bytes, '0', '9');
+            const __m128i underscores = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_'));
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, digits), underscores)));
+        }
+
+        std::size_t SkipWhitespaceSse2(const std::string_view text, std::size_t position) {
+            while (position + 16 <= text.size()) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+                const std::uint32_t inRun = WhitespaceMask128(bytes);
+                if (inRun != 0xFFFF) return position + __builtin_ctz(~inRun);
+                position += 16;
+            }
+            return Scalar::SkipWhitespace(text, position);
+        }
+
+        std::size_t FindQuoteOrBackslashSse2(const std::string_view text, std::size_t position) {
+            for (; position + 16 <= text.size(); position += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+                const auto found = static_cast<std::uint32_t>(_mm_movemask_epi8(
+                    _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\')))));
+                if (found != 0) return position + __builtin_ctz(found);
+            }
+            return Scalar::FindQuoteOrBackslash(text, position);
+        }
+
+        // ASCII blocks are skipped on the sign bits alone. SSE2 has no byte shuffle for the table lookups the AVX2
+        // kernel validates with, so a multibyte sequence is decoded on its own, and the search carries on after it.
+        std::size_t FindInvalidUtf8Sse2(const std::string_view text, std::size_t position) {
+            while (position + 16 <= text.size()) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+                const auto nonAscii = static_cast<std::uint32_t>(_mm_movemask_epi8(bytes));
+                if (nonAscii == 0) {
+                    position += 16;
+                    continue;
+                }
+
+                position += __builtin_ctz(nonAscii);
+                std::uint32_t codePoint = 0;
+                const std::size_t length = DecodeUtf8(text, position, codePoint);
+                if (length == 0) return position;
+                position += length;
+            }
+            return Scalar::FindInvalidUtf8(text, position);
+        }
+
+        void FindLineStartsSse2(const std::string_view text, std::size_t position, std::vector<std::uint32_t>& lineStarts) {
+            for (; position + 16 <= text.size(); position += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+                AppendLineStarts(static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')))),
+                                 position, lineStarts);
+            }
+            FindLineStartsScalar(text, position, lineStarts);
+        }
+
+        std::size_t SkipIdentifierCharsSse2(const std::string_view text, std::size_t position) {
+            while (position + 16 <= text.size()) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+                const std::uint32_t inRun = IdentifierMask128(bytes);
+                if (inRun != 0xFFFF) return position + __builtin_ctz(~inRun);
+                position += 16;
+            }
+            return Scalar::SkipIdentifierChars(text, position);
+        }
+
+        std::size_t SkipDigitsSse2(const std::string_view text, std::size_t position) {
+            while (position + 16 <= text.size()) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+                const auto inRun = static_cast<std::uint32_t>(_mm_movemask_epi8(InRange128(bytes, '0', '9')));
+                if (inRun != 0xFFFF) return position + __builtin_ctz(~inRun);
+                position += 16;
+            }
+            return Scalar::SkipDigits(text, position);
+        }
+
+        __attribute__((target("avx2"))) __m256i InRange256(const __m256i bytes, const char low, const char high) {
+            return _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(static_cast<char>(low - 1))),
+                                    _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(high + 1)), bytes));
+        }
+
+        __attribute__((target("avx2"))) std::size_t SkipWhitespaceAvx2(const std::string_view text, std::size_t position) {
+            while (position + 32 <= text.size()) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + position));
+                const __m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                                                       _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t')));
+                const __m256i breaks = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')),
+                                                       _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')));
+                const auto inRun = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(spaces, breaks)));
+                if (inRun != 0xFFFFFFFF) return position + __builtin_ctz(~inRun);
+                position += 32;
+            }
+            return SkipWhitespaceSse2(text, position);
+        }
+
+        __attribute__((target("avx2"))) std::size_t FindQuoteOrBackslashAvx2(const std::string_view text, std::size_t position) {
+            for (; position + 32 <= text.size(); position += 32) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + position));
+                const auto found = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(
+                    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\')))));
+                if (found != 0) return position + __builtin_ctz(found);
+            }
+            return FindQuoteOrBackslashSse2(text, position);
+        }
+
+        // Keiser and Lemire's lookup-table validation: three lookups, on the high and low nibbles of the byte before and
+        // the high nibble of each byte, each give the set of errors that pair could be part of. A byte whose three sets
+        // share an error is invalid. Those sets cover every malformed pair (overlong forms, surrogates, values past
+        // U+10FFFF, a missing or stray continuation byte); missing and extra third and fourth bytes are caught by
+        // comparing against the bytes two and three back.
+        constexpr std::uint8_t tooShort = 1 << 0; // A lead byte or ASCII after a lead byte.
+        constexpr std::uint8_t tooLong = 1 << 1; // A continuation byte after ASCII.
+        constexpr std::uint8_t overlong3 = 1 << 2; // E0 followed by 80-9F.
+        constexpr std::uint8_t tooLarge = 1 << 3; // F4 followed by 90-BF, or F5-FF.
+        constexpr std::uint8_t surrogate = 1 << 4; // ED followed by A0-BF.
+        constexpr std::uint8_t overlong2 = 1 << 5; // C0 or C1.
+        constexpr std::uint8_t tooLarge1000 = 1 << 6; // F5-FF followed by 80-8F. Shares its bit with overlong4.
+        constexpr std::uint8_t overlong4 = 1 << 6; // F0 followed by 80-8F.
+        constexpr std::uint8_t twoContinuations = 1 << 7; // A continuation byte after another, which must be expected.
+        constexpr std::uint8_t carry = tooShort | tooLong | twoContinuations; // Decided by the high nibbles alone.
+
+        __attribute__((target("avx2"))) __m256i Lookup256(const __m256i nibbles, const __m128i table) {
+            return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(table), nibbles);
+        }
+
+        __attribute__((target("avx2"))) __m256i HighNibbles256(const __m256i bytes) {
+            return _mm256_and_si256(_mm256_srli_epi16(bytes, 4), _mm256_set1_epi8(0x0F));
+        }
+
+        // The block shifted right by count bytes, with the end of the previous block shifted in.
+        template <int count>
+        __attribute__((target("avx2"))) __m256i Previous256(const __m256i bytes, const __m256i previous) {
+            return _mm256_alignr_epi8(bytes, _mm256_permute2x128_si256(previous, bytes, 0x21), 16 - count);
+        }
+
+        // Non-zero in every byte of the block that is not valid where it stands.
+        __attribute__((target("avx2"))) __m256i Utf8Errors256(const __m256i bytes, const __m256i previous) {
+            const auto table = [](const std::uint8_t (&entries)[16]) {
+                return _mm_loadu_si128(reinterpret_cast<const __m128i*>(entries));
+            };
+            static constexpr std::uint8_t byte1High[16] = {
+                tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+                twoContinuations, twoContinuations, twoContinuations, twoContinuations,
+                tooShort | overlong2, tooShort, tooShort | overlong3 | surrogate,
+                tooShort | tooLarge | tooLarge1000 | overlong4
+            };
+            static constexpr std::uint8_t byte1Low[16] = {
+                carry | overlong3 | overlong2 | overlong4, carry | overlong2, carry, carry,
+                carry | tooLarge, carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+                carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+                carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+                carry | tooLarge | tooLarge1000 | surrogate, carry | tooLarge | tooLarge1000,
+                carry | tooLarge | tooLarge1000
+            };
+            static constexpr std::uint8_t byte2High[16] = {
+                tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort,
+                tooLong | overlong2 | twoContinuations | overlong3 | tooLarge1000 | overlong4,
+                tooLong | overlong2 | twoContinuations | overlong3 | tooLarge,
+                tooLong | overlong2 | twoContinuations | surrogate | tooLarge,
+                tooLong | overlong2 | twoContinuations | surrogate | tooLarge,
+                tooShort, tooShort, tooShort, tooShort
+            };
+
+            const __m256i previous1 = Previous256<1>(bytes, previous);
+            const __m256i pairs = _mm256_and_si256(
+                _mm256_and_si256(Lookup256(HighNibbles256(previous1), table(byte1High)),
+                                 Lookup256(_mm256_and_si256(previous1, _mm256_set1_epi8(0x0F)), table(byte1Low))),
+                Lookup256(HighNibbles256(bytes), table(byte2High)));
+
+            // A byte two after an E0-FF lead, or three after an F0-FF lead, must be a continuation byte. Those are the
+            // only continuations flagged twoContinuations above, so the two must agree.
+            const __m256i third = _mm256_subs_epu8(Previous256<2>(bytes, previous), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+            const __m256i fourth = _mm256_subs_epu8(Previous256<3>(bytes, previous), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+            const __m256i expected = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+            return _mm256_xor_si256(pairs, expected);
+        }
+
+        // Non-zero if the block ends partway through a sequence, which the next block then has to finish.
+        __attribute__((target("avx2"))) __m256i Utf8Incomplete256(const __m256i bytes) {
+            const __m256i limits = _mm256_setr_epi8(
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+            return _mm256_subs_epu8(bytes, limits);
+        }
+
+        // Validates a block at a time with the lookup tables above, skipping ASCII blocks on their sign bits. A block
+        // with an error is decoded one sequence at a time from the sequence it starts in, to find where the error is.
+        __attribute__((target("avx2"))) std::size_t FindInvalidUtf8Avx2(const std::string_view text, std::size_t position) {
+            // Everything before a block is valid, apart from at most the lead and two continuation bytes of a sequence
+            // cut by the block boundary. Decoding resumes from the start of the last sequence before the block.
+            const auto lastSequenceStart = [&text, position](const std::size_t block) {
+                std::size_t sequence = block;
+                while (sequence > position && block - sequence < 4) {
+                    if ((static_cast<std::uint8_t>(text[--sequence]) & 0xC0) != 0x80) break;
+                }
+                return sequence;
+            };
+
+            std::size_t block = position;
+            __m256i previous = _mm256_setzero_si256(); // position starts a sequence, so what came before acts as ASCII.
+            __m256i incomplete = _mm256_setzero_si256();
+
+            while (block + 32 <= text.size()) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + block));
+                __m256i errors;
+                if (_mm256_movemask_epi8(bytes) == 0) {
+                    errors = incomplete;
+                    incomplete = _mm256_setzero_si256();
+                } else {
+                    errors = Utf8Errors256(bytes, previous);
+                    incomplete = Utf8Incomplete256(bytes);
+                }
+
+                if (_mm256_testz_si256(errors, errors)) {
+                    previous = bytes;
+                    block += 32;
+                    continue;
+                }
+
+                std::size_t sequence = lastSequenceStart(block);
+                while (sequence < block + 32) {
+                    std::uint32_t codePoint = 0;
+                    const std::size_t length = DecodeUtf8(text, sequence, codePoint);
+                    if (length == 0) return sequence;
+                    sequence += length;
+                }
+
+                // Not reached while the tables and DecodeUtf8 agree; carry on from a sequence start regardless.
+                block = sequence;
+                previous = _mm256_setzero_si256();
+                incomplete = _mm256_setzero_si256();
+            }
+
+            return FindInvalidUtf8Sse2(text, lastSequenceStart(block));
+        }
+
+        __attribute__((target("avx2"))) void FindLineStartsAvx2(const std::string_view text, std::size_t position,
+                                                               std::vector<std::uint32_t>& lineStarts) {
+            for (; position + 32 <= text.size(); position += 32) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + position));
+                AppendLineStarts(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')))),
+                                 position, lineStarts);
+            }
+            FindLineStartsSse2(text, position, lineStarts);
+        }
+
+        __attribute__((target("avx2"))) std::size_t SkipIdentifierCharsAvx2(const std::string_view text, std::size_t position) {
+            while (position + 32 <= text.size()) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + position));
+                const __m256i lower = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+                const __m256i letters = InRange256(lower, 'a', 'z');
+                const __m256i digits = InRange256(bytes, '0', '9');
+                const __m256i underscores = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_'));
+                const auto inRun = static_cast<std::uint32_t>(
+                    _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letters, digits), underscores)));
+                if (inRun != 0xFFFFFFFF) return position + __builtin_ctz(~inRun);
+                position += 32;
+            }
+            return SkipIdentifierCharsSse2(text, position);
+        }
+
+        __attribute__((target("avx2"))) std::size_t SkipDigitsAvx2(const std::string_view text, std::size_t position) {
+            while (position + 32 <= text.size()) {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + position));
+                const auto inRun = static_cast<std::uint32_t>(_mm256_movemask_epi8(InRange256(bytes, '0', '9')));
+                if (inRun != 0xFFFFFFFF) return position + __builtin_ctz(~inRun);
+                position += 32;
+            }
+            return SkipDigitsSse2(text, position);
+        }
+#endif
+
+        struct ScanFunctions {
+            ScanKernel kernel;
+            std::size_t (*skipWhitespace)(std::string_view, std::size_t);
+            std::size_t (*skipIdentifierChars)(std::string_view, std::size_t);
+            std::size_t (*skipDigits)(std::string_view, std::size_t);
+            std::size_t (*findQuoteOrBackslash)(std::string_view, std::size_t);
+            std::size_t (*findInvalidUtf8)(std::string_view, std::size_t);
+            void (*findLineStarts)(std::string_view, std::size_t, std::vector<std::uint32_t>&);
+        };
+
+        constexpr ScanFunctions scalarFunctions = {
+            ScanKernel::SCALAR, Scalar::SkipWhitespace, Scalar::SkipIdentifierChars, Scalar::SkipDigits,
+            Scalar::FindQuoteOrBackslash, Scalar::FindInvalidUtf8, FindLineStartsScalar
+        };
+#if VIREO_HAS_X86_SIMD
+        constexpr ScanFunctions sse2Functions = {
+            ScanKernel::SSE2, SkipWhitespaceSse2, SkipIdentifierCharsSse2, SkipDigitsSse2,
+            FindQuoteOrBackslashSse2, FindInvalidUtf8Sse2, FindLineStartsSse2
+        };
+        constexpr ScanFunctions avx2Functions = {
+            ScanKernel::AVX2, SkipWhitespaceAvx2, SkipIdentifierCharsAvx2, SkipDigitsAvx2,
+            FindQuoteOrBackslashAvx2, FindInvalidUtf8Avx2, FindLineStartsAvx2
+        };
+#endif
+
+        bool Supports(const ScanKernel kernel) {
+            switch (kernel) {
+                case ScanKernel::SCALAR: return true;
+#if VIREO_HAS_X86_SIMD
+                case ScanKernel::SSE2: return true; // Part of the x86-64 baseline.
+                case ScanKernel::AVX2: return __builtin_cpu_supports("avx2");
+#endif
+                default: return false;
+            }
+        }
+
+        const ScanFunctions* FunctionsFor(const ScanKernel kernel) {
+            switch (kernel) {
+#if VIREO_HAS_X86_SIMD
+                case ScanKernel::SSE2: return &sse2Functions;
+                case ScanKernel::AVX2: return &avx2Functions;
+#endif
+                default: return &scalarFunctions;
+            }
+        }
+
+        const ScanFunctions* DetectFunctions() {
+            if (Supports(ScanKernel::AVX2)) return FunctionsFor(ScanKernel::AVX2);
+            if (Supports(ScanKernel::SSE2)) return FunctionsFor(ScanKernel::SSE2);
+            return &scalarFunctions;
+        }
+
+        const ScanFunctions* ResolveFunctions();
+
+        // Stands in until the first call, which detects the CPU and forwards to the table it picked.
+        constexpr ScanFunctions detectingFunctions = {
+            ScanKernel::SCALAR,
+            [](const std::string_view text, const std::size_t position) {
+                return ResolveFunctions()->skipWhitespace(text, position);
+            },
+            [](const std::string_view text, const std::size_t position) {
+                return ResolveFunctions()->skipIdentifierChars(text, position);
+            },
+            [](const std::string_view text, const std::size_t position) {
+                return ResolveFunctions()->skipDigits(text, position);
+            },
+            [](const std::string_view text, const std::size_t position) {
+                return ResolveFunctions()->findQuoteOrBackslash(text, position);
+            },
+            [](const std::string_view text, const std::size_t position) {
+                return ResolveFunctions()->findInvalidUtf8(text, position);
+            },
+            [](const std::string_view text, const std::size_t from, std::vector<std::uint32_t>& lineStarts) {
+                ResolveFunctions()->findLineStarts(text, from, lineStarts);
+            }
+        };
+
+        // Constant-initialized, so lexing from another translation unit's static initializer finds a usable table
+        // rather than one that has not been set yet. Relaxed loads are plain loads on the hot path.
+        constinit std::atomic<const ScanFunctions*> activeFunctions{&detectingFunctions};
+
+        const ScanFunctions* Active() {
+            return activeFunctions.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Detects the CPU once and installs the fastest table, unless ForceScanKernel has picked one already.
+         *
+         * @returns The table now in use.
+         */
+        const ScanFunctions* ResolveFunctions() {
+            static const ScanFunctions* const detected = DetectFunctions();
+            const ScanFunctions* expected = &detectingFunctions;
+            activeFunctions.compare_exchange_strong(expected, detected, std::memory_order_relaxed);
+            return Active();
+        }
+    }
+
+    /**
+     * @brief Finds the end of a run of spaces, tabs, carriage returns and newlines.
+     *
+     * @param text The text to scan.
+     * @param position Where the run starts.
+     *
+     * @returns The index of the first character that is not whitespace.
+     */
+    std::size_t SkipWhitespace(const std::string_view text, const std::size_t position) {
+        return Active()->skipWhitespace(text, position);
+    }
+
+    /**
+     * @brief Finds the end of a run of ASCII letters, digits and underscores.
+     *
+     * @param text The text to scan.
+     * @param position Where the run starts.
+     *
+     * @returns The index of the first character that cannot continue an identifier.
+     */
+    std::size_t SkipIdentifierChars(const std::string_view text, const std::size_t position) {
+        return Active()->skipIdentifierChars(text, position);
+    }
+
+    /**
+     * @brief Finds the end of a run of ASCII digits.
+     *
+     * @param text The text to scan.
+     * @param position Where the run starts.
+     *
+     * @returns The index of the first character that is not a digit.
+     */
+    std::size_t SkipDigits(const std::string_view text, const std::size_t position) {
+        return Active()->skipDigits(text, position);
+    }
+
+    /**
+     * @brief Finds the next character that ends or escapes something inside a string literal.
+     *
+     * @param text The text to scan.
+     * @param position Where to start looking.
+     *
+     * @returns The index of the next '"' or '\\', or text.size() if there is none.
+     */
+    std::size_t FindQuoteOrBackslash(const std::string_view text, const std::size_t position) {
+        return Active()->findQuoteOrBackslash(text, position);
+    }
+
+    /**
+     * @brief Validates UTF-8. The AVX2 kernel checks a block at a time with lookup tables; the SSE2 kernel skips ASCII
+     * a block at a time and decodes anything else one sequence at a time.
+     *
+     * @param text The text to scan.
+     * @param position Where to start. Must be at the start of a sequence.
+     *
+     * @returns The index of the first byte of the first invalid sequence, or text.size() if the rest is valid.
+     */
+    std::size_t FindInvalidUtf8(const std::string_view text, const std::size_t position) {
+        return Active()->findInvalidUtf8(text, position);
+    }
+
+    /**
+     * @brief Finds the start of every line after the first, for building a line index.
+     *
+     * @param text The text to scan.
+     * @param lineStarts Receives the offset just past each '\n', in order.
+     */
+    void FindLineStarts(const std::string_view text, std::vector<std::uint32_t>& lineStarts) {
+        Active()->findLineStarts(text, 0, lineStarts);
+    }
+
+    /**
+     * @returns The scan implementation currently in use.
+     */
+    ScanKernel ActiveScanKernel() {
+        return ResolveFunctions()->kernel;
+    }
+
+    /**
+     * @brief Switches the scan implementation, for tests and benchmarks. Not safe while another thread is lexing.
+     *
+     * @param kernel The implementation to use.
+     *
+     * @returns Whether the CPU supports the kernel. The active kernel is left unchanged if it does not.
+     */
+    bool ForceScanKernel(const ScanKernel kernel) {
+        if (!Supports(kernel)) return false;
+        activeFunctions.store(FunctionsFor(kernel), std::memory_order_relaxed);
+        return true;
+    }
+}
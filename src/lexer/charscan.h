@@ -0,0 +1,95 @@
+#pragma once
+#ifndef CHARSCAN_H
+#define CHARSCAN_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "unicode.h"
+
+namespace Lexer {
+    /**
+     * @brief The implementation used to scan runs of characters. The fastest one the CPU supports is picked at startup.
+     */
+    enum class ScanKernel {
+        SCALAR, SSE2, AVX2
+    };
+
+    std::size_t SkipWhitespace(std::string_view text, std::size_t position);
+    std::size_t SkipIdentifierChars(std::string_view text, std::size_t position);
+    std::size_t SkipDigits(std::string_view text, std::size_t position);
+    std::size_t FindQuoteOrBackslash(std::string_view text, std::size_t position);
+    std::size_t FindInvalidUtf8(std::string_view text, std::size_t position);
+    void FindLineStarts(std::string_view text, std::vector<std::uint32_t>& lineStarts);
+
+    ScanKernel ActiveScanKernel();
+    bool ForceScanKernel(ScanKernel kernel);
+
+    // The byte-at-a-time scans. They are the SCALAR kernel and the vector kernels' fallback for short tails, and since
+    // they are constexpr the lexer core also runs them when it is constant-evaluated, where SIMD is not available.
+    namespace Scalar {
+        enum CharClass : std::uint8_t {
+            WHITESPACE = 1 << 0,
+            NEWLINE = 1 << 1,
+            DIGIT = 1 << 2,
+            IDENTIFIER = 1 << 3,
+        };
+
+        // Locale-independent classification of every byte value, so the scalar paths never call into <cctype>.
+        inline constexpr std::array<std::uint8_t, 256> charClasses = [] {
+            std::array<std::uint8_t, 256> classes{};
+            classes[' '] = classes['\t'] = classes['\r'] = WHITESPACE;
+            classes['\n'] = WHITESPACE | NEWLINE;
+            for (int c = '0'; c <= '9'; c++) classes[c] = DIGIT | IDENTIFIER;
+            for (int c = 'a'; c <= 'z'; c++) classes[c] = IDENTIFIER;
+            for (int c = 'A'; c <= 'Z'; c++) classes[c] = IDENTIFIER;
+            classes['_'] = IDENTIFIER;
+            return classes;
+        }();
+
+        constexpr bool Is(const char c, const std::uint8_t charClass) {
+            return (charClasses[static_cast<unsigned char>(c)] & charClass) != 0;
+        }
+
+        constexpr std::size_t Skip(const std::string_view text, std::size_t position, const std::uint8_t charClass) {
+            while (position < text.size() && Is(text[position], charClass)) {
+                position++;
+            }
+            return position;
+        }
+
+        constexpr std::size_t SkipWhitespace(const std::string_view text, const std::size_t position) {
+            return Skip(text, position, WHITESPACE);
+        }
+
+        constexpr std::size_t SkipIdentifierChars(const std::string_view text, const std::size_t position) {
+            return Skip(text, position, IDENTIFIER);
+        }
+
+        constexpr std::size_t SkipDigits(const std::string_view text, const std::size_t position) {
+            return Skip(text, position, DIGIT);
+        }
+
+        constexpr std::size_t FindQuoteOrBackslash(const std::string_view text, std::size_t position) {
+            while (position < text.size() && text[position] != '"' && text[position] != '\\') {
+                position++;
+            }
+            return position;
+        }
+
+        constexpr std::size_t FindInvalidUtf8(const std::string_view text, std::size_t position) {
+            while (position < text.size()) {
+                std::uint32_t codePoint = 0;
+                const std::size_t length = DecodeUtf8(text, position, codePoint);
+                if (length == 0) return position;
+                position += length;
+            }
+            return position;
+        }
+    }
+}
+
+#endif //CHARSCAN_H
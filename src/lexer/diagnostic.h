@@ -0,0 +1,46 @@
+#pragma once
+#ifndef DIAGNOSTIC_H
+#define DIAGNOSTIC_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace Lexer {
+    enum class DiagnosticKind {
+        INTEGER_OVERFLOW, // An integer literal does not fit in 64 bits.
+        FLOAT_OUT_OF_RANGE, // A float literal is too large for a double.
+        INVALID_ESCAPE, // A backslash in a string literal is not followed by a known escape. It is kept as written.
+        UNTERMINATED_STRING, // A string literal has no closing quote. It is produced as an UNKNOWN token.
+        UNTERMINATED_COMMENT, // A block comment has no closing "*/". It is produced as an UNKNOWN token.
+        INVALID_UTF8, // A run of bytes that is not valid UTF-8, either on its own as an UNKNOWN token or inside a string.
+        SOURCE_TOO_LARGE // A streamed source goes on past 4 GiB, which 32-bit offsets cannot address. Lexing stops there.
+    };
+
+    /**
+     * @brief A problem the lexer found in the source. The token it concerns is still produced.
+     */
+    struct Diagnostic {
+        DiagnosticKind kind;
+        std::uint32_t offset; // Byte offset of the problem, such as a bad escape inside a string literal.
+        std::uint32_t length;
+        std::uint32_t token; // Byte offset of the token the problem is in. Often the same as offset.
+    };
+
+    /**
+     * @returns A description of the diagnostic, for reporting.
+     */
+    constexpr std::string_view DiagnosticMessage(const DiagnosticKind kind) {
+        switch (kind) {
+            case DiagnosticKind::INTEGER_OVERFLOW: return "integer literal is too large for a 64-bit integer";
+            case DiagnosticKind::FLOAT_OUT_OF_RANGE: return "float literal is too large for a double";
+            case DiagnosticKind::INVALID_ESCAPE: return "invalid escape sequence in string literal";
+            case DiagnosticKind::UNTERMINATED_STRING: return "string literal is missing its closing quote";
+            case DiagnosticKind::UNTERMINATED_COMMENT: return "block comment is missing its closing */";
+            case DiagnosticKind::INVALID_UTF8: return "invalid UTF-8";
+            case DiagnosticKind::SOURCE_TOO_LARGE: return "source is larger than 4 GiB; lexing stopped";
+        }
+        return "unknown diagnostic";
+    }
+}
+
+#endif //DIAGNOSTIC_H
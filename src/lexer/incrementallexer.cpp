@@ -0,0 +1,74 @@
+#include "incrementallexer.h"
+#include "lexer.h"
+#include "sourcebuffer.h"
+#include "tokenspec.h"
+#include <algorithm>
+#include <span>
+
+namespace Lexer {
+    /**
+     * @brief Lexes the initial text in full.
+     *
+     * @param source The text to lex. It must outlive the lexer or be replaced through ApplyEdit.
+     */
+    IncrementalLexer::IncrementalLexer(const std::string_view source) {
+        Lexer lexer(SourceBuffer::View(source));
+        tokens = lexer.TokenizeStream();
+    }
+
+    /**
+     * @brief Brings the tokens up to date after an edit.
+     *
+     * @param newSource The whole text after the edit. It must outlive the lexer or be replaced by a later edit.
+     * @param edit What changed, in terms of the text before the edit.
+     *
+     * @returns The range of tokens that changed, with indices into the updated stream.
+     */
+    TokenRange IncrementalLexer::ApplyEdit(const std::string_view newSource, const TextEdit& edit) {
+        const std::int64_t delta = static_cast<std::int64_t>(edit.insertedLength) - static_cast<std::int64_t>(edit.removedLength);
+        const std::uint32_t oldEditEnd = edit.offset + edit.removedLength;
+        const std::uint32_t newEditEnd = edit.offset + edit.insertedLength;
+        const std::size_t eof = tokens.Size() - 1;
+
+        // Restart at the last token that begins far enough before the edit that neither it nor anything before it
+        // could have looked at the edited text.
+        // Offsets are sorted, so this is a binary search rather than a walk back from the end of the file.
+        std::size_t first = 0;
+        if (edit.offset >= maxLookahead) {
+            const std::span<const std::uint32_t> offsets = tokens.Offsets().first(eof);
+            const auto after = std::upper_bound(offsets.begin(), offsets.end(), edit.offset - maxLookahead);
+            if (after != offsets.begin()) first = static_cast<std::size_t>(after - offsets.begin()) - 1;
+        }
+
+        Lexer lexer(SourceBuffer::View(newSource));
+        lexer.Seek(first == 0 ? 0 : tokens.Offset(first));
+
+        TokenStream relexed(newSource);
+        std::size_t resume = first; // The first old token that may still be reused.
+
+        while (true) {
+            const Token token = lexer.NextToken();
+            if (token.type == TokenType::END_OF_FILE) {
+                resume = eof;
+                break;
+            }
+
+            if (token.offset >= newEditEnd) {
+                // Past the edit, an old token that starts at the same (shifted) place will lex identically from here on.
+                const std::int64_t oldOffset = static_cast<std::int64_t>(token.offset) - delta;
+                while (resume < eof && (tokens.Offset(resume) < oldEditEnd || tokens.Offset(resume) < oldOffset)) {
+                    resume++;
+                }
+                if (resume < eof && tokens.Offset(resume) == oldOffset) break;
+            }
+
+            relexed.Append(token);
+        }
+
+        tokens.Rebind(newSource);
+        tokens.ShiftOffsets(resume, delta);
+        tokens.Splice(first, resume - first, relexed);
+
+        return {first, resume - first, relexed.Size()};
+    }
+}
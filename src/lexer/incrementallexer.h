@@ -0,0 +1,52 @@
+#pragma once
+#ifndef INCREMENTALLEXER_H
+#define INCREMENTALLEXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "tokenstream.h"
+
+namespace Lexer {
+    /**
+     * @brief A change to a source buffer: removedLength bytes at offset were replaced by insertedLength new bytes.
+     */
+    struct TextEdit {
+        std::uint32_t offset;
+        std::uint32_t removedLength;
+        std::uint32_t insertedLength;
+    };
+
+    /**
+     * @brief The tokens an edit changed: removedCount old tokens from first were replaced by insertedCount new ones.
+     */
+    struct TokenRange {
+        std::size_t first;
+        std::size_t removedCount;
+        std::size_t insertedCount;
+    };
+
+    /**
+     * @brief Keeps a token stream up to date with a buffer that is being edited, re-lexing only around each edit.
+     *
+     * Lexing restarts at the last token that the edit cannot have influenced, given how far past a token's end the
+     * scanner may look. It stops as soon as a new token starts at the same place, relative to the unchanged text after
+     * the edit, as an old token did: from a token boundary the lexer's output depends only on the text ahead, so every
+     * later token is the same as before, just moved. Finding the restart point is a binary search and the re-lexing
+     * depends on the size of the edit, not of the file. Updating the stream is still linear in the tokens after the
+     * edit: their offsets are shifted and, when the token count changes, the arrays' tails are moved. Both are tight
+     * loops over flat arrays, but an edit near the top of a large file does touch every later token.
+     */
+    class IncrementalLexer {
+    private:
+        TokenStream tokens;
+    public:
+        explicit IncrementalLexer(std::string_view source);
+
+        const TokenStream& Tokens() const { return tokens; }
+        TokenRange ApplyEdit(std::string_view newSource, const TextEdit& edit);
+    };
+}
+
+#endif //INCREMENTALLEXER_H
@@ -0,0 +1,68 @@
+#include "interner.h"
+#include <functional>
+#include <mutex>
+
+namespace Lexer {
+    /**
+     * @returns The interner shared by the whole process.
+     */
+    Interner& Interner::Global() {
+        static Interner interner;
+        return interner;
+    }
+
+    /**
+     * @brief Finds the id for a string, adding the string if it has not been seen before.
+     *
+     * @param text The string to intern. It is copied, so it does not need to outlive the call.
+     *
+     * @returns The string's id, the same for every call with an equal string.
+     */
+    SymbolId Interner::Intern(const std::string_view text) {
+        const std::size_t hash = std::hash<std::string_view>()(text);
+        const std::size_t shardIndex = (hash >> 7) & (shardCount - 1); // Low bits pick the map's bucket, so skip them.
+        Shard& shard = shards[shardIndex];
+
+        {
+            std::shared_lock lock(shard.mutex);
+            if (const auto found = shard.ids.find(text); found != shard.ids.end()) {
+                return found->second;
+            }
+        }
+
+        std::unique_lock lock(shard.mutex);
+        if (const auto found = shard.ids.find(text); found != shard.ids.end()) {
+            return found->second; // Another thread added it between the two locks.
+        }
+
+        const std::string_view stored = shard.arena.Store(text);
+        shard.spellings.push_back(stored);
+
+        const auto id = static_cast<SymbolId>((shard.spellings.size() << shardBits) | shardIndex);
+        shard.ids.emplace(stored, id);
+        return id;
+    }
+
+    /**
+     * @param id An id returned by Intern.
+     *
+     * @returns The string the id stands for, valid for the lifetime of the interner.
+     */
+    std::string_view Interner::Spelling(const SymbolId id) const {
+        const Shard& shard = shards[id & (shardCount - 1)];
+        std::shared_lock lock(shard.mutex);
+        return shard.spellings[(id >> shardBits) - 1];
+    }
+
+    /**
+     * @returns How many distinct strings have been interned.
+     */
+    std::size_t Interner::Size() const {
+        std::size_t size = 0;
+        for (const Shard& shard : shards) {
+            std::shared_lock lock(shard.mutex);
+            size += shard.spellings.size();
+        }
+        return size;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+
+namespace Lexer {
+    // A compact handle for an interned identifier. Two identifiers have the same id exactly when they are spelled the
+    // same, so comparing ids replaces comparing strings. Zero is never handed out and means "no symbol".
+    using SymbolId = std::uint32_t;
+
+    /**
+     * @brief A thread-safe string interner shared by every lexer in the process.
+     *
+     * The table is split into shards picked by the hash of the string, each with its own lock and arena, so threads
+     * lexing different files rarely contend. Lookups of strings that are already interned only take a shared lock.
+     */
+    class Interner {
+    private:
+        static constexpr unsigned shardBits = 6;
+        static constexpr std::size_t shardCount = std::size_t{1} << shardBits;
+
+        struct Shard {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<std::string_view, SymbolId> ids; // Keys view strings stored in arena.
+            std::vector<std::string_view> spellings; // By the id's index within the shard.
+            Arena arena;
+        };
+
+        std::array<Shard, shardCount> shards;
+    public:
+        Interner() = default;
+        Interner(const Interner&) = delete;
+        Interner& operator=(const Interner&) = delete;
+
+        static Interner& Global();
+
+        SymbolId Intern(std::string_view text);
+        std::string_view Spelling(SymbolId id) const;
+        std::size_t Size() const;
+    };
+}
+
+#endif //INTERNER_H
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "tokenspec.h"
+
+namespace Lexer {
+    struct Keyword {
+        std::string_view spelling;
+        TokenType type;
+    };
+
+    // The keywords from tokenSpecs, gathered into their own array so the hash below can be built over them.
+    inline constexpr auto keywords = [] {
+        std::array<Keyword, CountTokenSpecs(TokenKind::KEYWORD)> result{};
+        std::size_t count = 0;
+        for (const TokenSpec& spec : tokenSpecs) {
+            if (spec.kind == TokenKind::KEYWORD) result[count++] = {spec.spelling, spec.type};
+        }
+        return result;
+    }();
+
+    /**
+     * @brief A perfect hash over the keyword set, built entirely at compile time.
+     *
+     * A word hashes from its length and its first and last characters. The multiplier for the length is searched for
+     * at compile time so that no two keywords share a slot, which means a lookup is one hash, one table load and one
+     * short comparison, with no allocation.
+     */
+    namespace KeywordHash {
+        inline constexpr std::size_t tableSize = 32;
+
+        constexpr std::size_t Hash(const std::string_view word, const std::uint32_t seed) {
+            return (word.size() * seed + static_cast<unsigned char>(word.front()) * 3u
+                    + static_cast<unsigned char>(word.back())) & (tableSize - 1);
+        }
+
+        constexpr bool IsPerfect(const std::uint32_t seed) {
+            std::array<bool, tableSize> used{};
+            for (const Keyword& keyword : keywords) {
+                const std::size_t slot = Hash(keyword.spelling, seed);
+                if (used[slot]) return false;
+                used[slot] = true;
+            }
+            return true;
+        }
+
+        constexpr std::uint32_t FindSeed() {
+            for (std::uint32_t seed = 1; seed < 1024; seed++) {
+                if (IsPerfect(seed)) return seed;
+            }
+            return 0;
+        }
+
+        inline constexpr std::uint32_t seed = FindSeed();
+        static_assert(seed != 0, "No perfect hash seed for the keyword set; grow tableSize or change Hash.");
+
+        inline constexpr auto table = [] {
+            std::array<Keyword, tableSize> slots{};
+            for (Keyword& slot : slots) slot = {"", TokenType::IDENTIFIER};
+            for (const Keyword& keyword : keywords) slots[Hash(keyword.spelling, seed)] = keyword;
+            return slots;
+        }();
+
+        inline constexpr std::size_t minLength = [] {
+            std::size_t length = keywords[0].spelling.size();
+            for (const Keyword& keyword : keywords) length = keyword.spelling.size() < length ? keyword.spelling.size() : length;
+            return length;
+        }();
+
+        inline constexpr std::size_t maxLength = [] {
+            std::size_t length = 0;
+            for (const Keyword& keyword : keywords) length = keyword.spelling.size() > length ? keyword.spelling.size() : length;
+            return length;
+        }();
+    }
+
+    /**
+     * @brief Classifies a word as a keyword or a plain identifier.
+     *
+     * @param word The text of an identifier-shaped token.
+     *
+     * @returns The keyword's TokenType, or TokenType::IDENTIFIER if the word is not a keyword.
+     */
+    constexpr TokenType LookupKeyword(const std::string_view word) {
+        if (word.size() < KeywordHash::minLength || word.size() > KeywordHash::maxLength) return TokenType::IDENTIFIER;
+
+        const Keyword& candidate = KeywordHash::table[KeywordHash::Hash(word, KeywordHash::seed)];
+        return candidate.spelling == word ? candidate.type : TokenType::IDENTIFIER;
+    }
+}
+
+#endif //KEYWORDS_H
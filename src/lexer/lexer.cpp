@@ -1,248 +1,323 @@
 #include "lexer.h"
 #include "token.h"
+#include "interner.h"
+#include "perfcounters.h"
+#include "tokencache.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <vector>
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include <utility>
 
 namespace Lexer {
+    namespace {
+        // Pulls tokens from the lexer into any vector-like container until END_OF_FILE.
+        template <typename Tokens>
+        void Drain(Lexer& lexer, Tokens& tokens) {
+            do {
+                tokens.push_back(lexer.NextToken());
+            } while (tokens.back().type != TokenType::END_OF_FILE);
+        }
+
+        // Guesses how many tokens the source holds from how densely its first few KiB are packed, with an eighth more
+        // for slack, so a vector can be sized once. Sources no longer than the sample get 0, and just grow. Leaves the
+        // lexer rewound.
+        std::size_t EstimateTokenCount(Lexer& lexer, const std::size_t sourceSize) {
+            constexpr std::size_t sampleSize = 4096;
+            if (sourceSize <= sampleSize) return 0;
+
+            lexer.Rewind();
+            std::size_t sampled = 0;
+            while (lexer.Position() < sampleSize && lexer.NextToken().type != TokenType::END_OF_FILE) {
+                sampled++;
+            }
+            const std::size_t covered = std::max<std::size_t>(lexer.Position(), 1);
+            lexer.Rewind();
+
+            const std::size_t estimate = sampled * sourceSize / covered;
+            return estimate + estimate / 8 + 1;
+        }
+
+        // Unpacks a stream into any vector-like container. Lexemes the stream keeps outside the source are copied into
+        // the arena, since the stream does not outlive this call.
+        template <typename Tokens>
+        void Unpack(const TokenStream& stream, Tokens& tokens, Arena& arena) {
+            const std::string_view source = stream.Source();
+            tokens.reserve(tokens.size() + stream.Size());
+            for (std::size_t i = 0; i < stream.Size(); i++) {
+                Token token = stream[i];
+                if (const char* data = token.lexeme.data();
+                    std::less<const char*>()(data, source.data()) ||
+                    std::greater<const char*>()(data + token.lexeme.size(), source.data() + source.size())) {
+                    token.lexeme = arena.Store(token.lexeme);
+                }
+                tokens.push_back(token);
+            }
+        }
+    }
+
     // Main Functions
     /**
      * @brief Creates the object for the lexer, reads the source code file and parses it into a string, and sets the starting and current positions.
      *
      * @param source The path to the file that contains the source code.
      * @param fromFile Has the lexer read the file from the file path if it is, or just use the source as the sourceCode
+     * @param arena Where to keep lexemes that are not a slice of the source. If null, the lexer uses an arena of its own.
+     *
+     * @throws std::system_error If fromFile is set and the file cannot be opened or read.
      */
-    Lexer::Lexer(const std::string& source, bool fromFile) {
-        if (fromFile) {
-            sourceCode = ConvertSourceToString(source);
-        } else {
-            sourceCode = source;
-        }
-        currentLine = 1;
-        currentChar = 0;
+    Lexer::Lexer(const std::string& source, bool fromFile, Arena* arena)
+        : Lexer(fromFile ? SourceBuffer::FromFile(source) : SourceBuffer::FromString(source), arena) {}
 
-        start = 0;
-        current = 0;
+    /**
+     * @brief Creates the lexer over an already loaded source buffer, such as a memory-mapped file.
+     *
+     * @param source The buffer holding the source code. The lexer takes ownership of it.
+     * @param arena Where to keep lexemes that are not a slice of the source. If null, the lexer uses an arena of its own.
+     */
+    Lexer::Lexer(SourceBuffer source, Arena* arena) : source(std::move(source)), arena(arena ? arena : &localArena) {
+        sourceCode = this->source.Text();
     }
 
     /**
-     * @returns A list of tokens converted from the source code
+     * @brief Points the lexer at new source code, keeping the capacity it has built up so far.
+     *
+     * Meant for lexing many short scripts with one instance. Once its buffers have grown to fit, re-lexing with Reset
+     * and Tokenize(std::vector<Token>&) does not touch the heap. Tokens from before the reset become invalid, and a
+     * line index, if one was built, is rebuilt on the next Locate.
+     *
+     * @param source The new source code. It is viewed, not copied, so it must outlive the lexer's use of it.
      */
-    std::vector<Token> Lexer::Tokenize() {
-        start = 0;
+    void Lexer::Reset(const std::string_view source) {
+        this->source = SourceBuffer::View(source);
+        sourceCode = this->source.Text();
+        lineIndex.reset();
 
-        while (!IsAtEnd()) {
-            start = current;
-            ScanToken();
+        // A caller's arena may hold lexemes the caller still needs, so only the lexer's own is recycled.
+        if (arena == &localArena) {
+            localArena.Rewind();
         }
+        Rewind();
+    }
 
-        tokens.emplace_back(TokenType::END_OF_FILE, "", currentLine);
-
+    /**
+     * @brief Lexes the whole source code in one go, from the start no matter how much has been read already.
+     *
+     * @returns A list of tokens converted from the source code, ending with END_OF_FILE.
+     */
+    std::vector<Token> Lexer::Tokenize() {
+        std::vector<Token> tokens;
+        Tokenize(tokens);
         return tokens;
     }
 
     /**
-     * @brief Scans the contents of file path and extracts them into a string.
-     *
-     * @param filePath The string that contains the path to the target source code.
+     * @brief Lexes the whole source code into an existing vector, reusing its capacity.
      *
-     * @returns The contents of the source code folder.
-    **/
-    // Helper Functions
-    std::string Lexer::ConvertSourceToString(const std::string& filePath) {
-        std::ifstream file(filePath);
-
-        if (!file.is_open()) {
-            return "";
+     * @param tokens Cleared, then filled with the tokens converted from the source code, ending with END_OF_FILE.
+     */
+    void Lexer::Tokenize(std::vector<Token>& tokens) {
+        tokens.clear();
+        if (cache) {
+            Unpack(TokenizeStream(), tokens, *arena);
+            return;
         }
 
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        return buffer.str();
+        Rewind();
+        Drain(*this, tokens);
     }
 
     /**
-     * @brief Scans the current token to check if it is a possible token.
-    */
-    void Lexer::ScanToken() {
-        char c = Advance();
-        switch (c) {
-            case '+': AddToken(TokenType::PLUS); break;
-            case '-':
-                if (Peek() == '>') {
-                    Advance();
-                    AddToken(TokenType::ARROW);
-                } else {
-                    AddToken(TokenType::MINUS);
-                }
-                break;
-            case '*': AddToken(TokenType::MUL); break;
-            case '/': AddToken(TokenType::DIV); break;
-            case '=':
-                if (Peek() == '=') {
-                    Advance(); // Consume the second '='
-                    AddToken(TokenType::EQUAL_TO);
-                } else {
-                    AddToken(TokenType::ASSIGN);
-                }
-                break;
-            case '<': AddToken(TokenType::LESS); break;
-            case '>': AddToken(TokenType::GREATER); break;
-            case '&':
-                if (Peek() == '&') {
-                    Advance(); // Consume second '&'
-                    AddToken(TokenType::AND);
-                } else {
-                    AddToken(TokenType::UNKNOWN);
-                }
-                break;
-            case '|':
-                if (Peek() == '|') {
-                    Advance(); // Consume second '|'
-                    AddToken(TokenType::OR);
-                } else {
-                    AddToken(TokenType::UNKNOWN);
-                }
-                break;
-            case '(': AddToken(TokenType::LEFT_PAREN); break;
-            case ')': AddToken(TokenType::RIGHT_PAREN); break;
-            case '{': AddToken(TokenType::LEFT_BRACE); break;
-            case '}': AddToken(TokenType::RIGHT_BRACE); break;
-            case ',': AddToken(TokenType::COMMA); break;
-            case ':': AddToken(TokenType::COLON); break;
-            case ';': AddToken(TokenType::SEMICOLON); break;
-            case '"': String(); break;
-            case ' ':
-            case '\t':
-            case '\r':
-            case '\n':
-                break;
-            default: {
-                if (std::isdigit(static_cast<unsigned char>(c)))
-                    Number();
-                else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
-                    Identifier();
-                else
-                    AddToken(TokenType::UNKNOWN);
-                break;
-            }
+     * @brief Lexes the whole source code into a vector whose storage comes from the given memory resource.
+     *
+     * Passing an Arena keeps every token of a compilation unit in a few large blocks, released together with the arena.
+     * An arena never reuses what a growing vector leaves behind, so the vector is sized once up front from the token
+     * density of the start of the source rather than grown from empty.
+     *
+     * @param resource Where the vector allocates from.
+     *
+     * @returns A list of tokens converted from the source code, ending with END_OF_FILE.
+     */
+    std::pmr::vector<Token> Lexer::Tokenize(std::pmr::memory_resource* resource) {
+        std::pmr::vector<Token> tokens(resource);
+        if (cache) {
+            Unpack(TokenizeStream(), tokens, *arena);
+            return tokens;
         }
-    }
 
+        tokens.reserve(EstimateTokenCount(*this, sourceCode.size()));
+        Rewind();
+        Drain(*this, tokens);
+        return tokens;
+    }
 
     /**
-     * @brief Advances the current character that the source code is on.
+     * @brief Lexes the whole source code into a struct-of-arrays stream.
      *
-     * @returns The character that it just passed.
-    */
-    char Lexer::Advance() {
-        const char c = sourceCode[current++];  // Read current, then advance
+     * With a cache in use, a hit skips lexing altogether and a miss stores the result for next time.
+     *
+     * @returns The tokens converted from the source code, ending with END_OF_FILE.
+     */
+    TokenStream Lexer::TokenizeStream() {
+        TokenStream tokens(sourceCode);
+        Rewind();
 
-        if (c == '\n') {
-            currentLine++;
-            currentChar = 0;
-        } else {
-            currentChar++;
+        if (cache && cache->Load(sourceCode, CacheOptions(), tokens, diagnostics)) {
+            Seek(sourceCode.size());
+            return tokens;
+        }
+
+        while (true) {
+            const Token token = NextToken();
+            tokens.Append(token);
+            if (token.type == TokenType::END_OF_FILE) break;
         }
 
-        return c;
+        if (cache) {
+            cache->Store(tokens, CacheOptions(), diagnostics);
+        }
+        return tokens;
     }
 
     /**
-     * @brief Read digits in the source code to form an integer or float literal.
+     * @brief Lexes and hands out the next token, so large inputs can be processed without holding every token.
+     *
+     * @returns The next token in the source code. Once the source is exhausted, every call returns END_OF_FILE.
      */
-    void Lexer::Number() {
-        while (std::isdigit(Peek())) {
-            Advance();
+    Token Lexer::NextToken() {
+        if (lookahead) {
+            const Token token = *lookahead;
+            lookahead.reset();
+            return token;
         }
 
-        if (Peek() == '.' && std::isdigit(PeekNext())) {
-            Advance();
-
-            while (std::isdigit(Peek())) {
-                Advance();
+        while (!IsAtEnd()) {
+            start = current;
+            {
+                VIREO_PERF_PHASE(SCAN);
+                ScanToken();
             }
 
-            AddToken(TokenType::FLOAT_LITERAL);
-        } else {
-            AddToken(TokenType::INT_LITERAL);
+            // Whitespace is scanned without producing a token, so keep going until something is added.
+            if (scannedToken) {
+                const Token token = *scannedToken;
+                scannedToken.reset();
+                return token;
+            }
         }
+
+        start = current;
+        return {TokenType::END_OF_FILE, "", static_cast<std::uint32_t>(current)};
     }
 
     /**
-     * @brief Read the source code as long as characters are letters, digits, or underscores and add a token identifier
-    */
-    void Lexer::Identifier() {
-        while (std::isalnum(Peek()) || Peek() == '_') {
-            Advance();
+     * @brief Looks one token ahead without consuming it.
+     *
+     * @returns The token the next call to NextToken will return.
+     */
+    const Token& Lexer::PeekToken() {
+        if (!lookahead) {
+            lookahead = NextToken();
         }
+        return *lookahead;
+    }
 
-        std::string identifier = sourceCode.substr(start, current - start);
-
-        if (const auto tokenType = keywordMap.find(identifier); tokenType != keywordMap.end()) {
-            AddToken(tokenType->second);
-        } else {
-            AddToken(TokenType::IDENTIFIER);
-        }
+    /**
+     * @brief Moves the lexer to another position in the source, dropping any token read ahead.
+     *
+     * TokenStart() and Position() report the most recently scanned token's start and end, so together with Seek a
+     * caller can lex any slice of the buffer that begins on a token boundary.
+     *
+     * @param position Where lexing continues. Must not fall inside a token.
+     */
+    void Lexer::Seek(const std::size_t position) {
+        start = position;
+        current = position;
+        scannedToken.reset();
+        lookahead.reset();
     }
 
     /**
-     * @brief Extracts a string literal from a pair of double quotes.
-    */
-    void Lexer::String() {
-        while (Peek() != '"' && !IsAtEnd()) {
-            Advance();
-        }
+     * @brief Goes back to the start of the source and forgets the diagnostics of any earlier pass over it.
+     */
+    void Lexer::Rewind() {
+        Seek(0);
+        diagnostics.clear();
+    }
 
-        if (IsAtEnd()) {
-            AddToken(TokenType::UNKNOWN);
-            return;
+    /**
+     * @brief Resolves a byte offset in the source to a line and column, building the line index on first use.
+     *
+     * @param offset A byte offset into the source, such as Token::offset.
+     *
+     * @returns The 1-based line and column of the offset.
+     */
+    SourceLocation Lexer::Locate(const std::uint32_t offset) const {
+        if (!lineIndex) {
+            lineIndex.emplace(sourceCode);
         }
+        return lineIndex->Locate(offset);
+    }
 
-        Advance();
+    /**
+     * @brief Starts iterating over the lexer's remaining tokens.
+     *
+     * @param lexer The lexer to pull tokens from.
+     */
+    TokenIterator::TokenIterator(Lexer& lexer) : lexer(&lexer), token(lexer.NextToken()) {}
 
-        const std::string value = sourceCode.substr(start + 1, current - start - 2);
-        AddToken(TokenType::STRING_LITERAL, value);
+    /**
+     * @brief Pulls the next token, or ends the iteration once END_OF_FILE has been seen.
+     */
+    TokenIterator& TokenIterator::operator++() {
+        if (token->type == TokenType::END_OF_FILE) {
+            token.reset();
+        } else {
+            token = lexer->NextToken();
+        }
+        return *this;
     }
 
     /**
-     * @brief Adds a token to the list of tokens that the lexer will pass to the parser.
+     * @brief Scans the contents of file path and extracts them into a string.
      *
-     * @param type The type of token to add to the list of tokens
-    */
-    void Lexer::AddToken(TokenType type, const std::string& lexeme) {
-        std::string finalLexeme = lexeme.empty() ? sourceCode.substr(start, current - start) : lexeme;
-        tokens.emplace_back(type, finalLexeme, currentLine);
+     * The lexer itself reads files through SourceBuffer::FromFile and does not copy them; this is for callers that
+     * need their own copy of the text.
+     *
+     * @param filePath The string that contains the path to the target source code.
+     *
+     * @returns The contents of the source code folder.
+     *
+     * @throws std::system_error If the file cannot be opened or read.
+    **/
+    // Helper Functions
+    std::string Lexer::ConvertSourceToString(const std::string& filePath) {
+        return std::string(SourceBuffer::FromFile(filePath).Text());
     }
 
     /**
-     * @brief Checks the current character.
-     *
-     * @returns The next character that the lexer will read.
+     * @returns The settings that change what tokens are produced, as part of the cache key.
      */
-    char Lexer::Peek() const {
-        if (current >= sourceCode.size()) return '\0';
-        return sourceCode[current];
+    std::uint32_t Lexer::CacheOptions() const {
+        return keepComments ? 1 : 0;
     }
 
     /**
-     * @brief Shows the next character that is waiting in the queue.
+     * @brief Receives a token from the scanner and holds it for NextToken, which passes it on to the parser.
      *
-     * @return The next character in the queue.
+     * @param type The type of token to add
+     * @param lexeme A view that must outlive the token, normally into sourceCode.
+     * @param payload The token's decoded value, if its type has one.
     */
-    char Lexer::PeekNext() const {
-        if (current + 1 >= sourceCode.size()) return '\0';
-        return sourceCode[current + 1];
+    void Lexer::Emit(const TokenType type, const std::string_view lexeme, const std::uint64_t payload) {
+        VIREO_PERF_PHASE(EMIT);
+        scannedToken.emplace(type, lexeme, static_cast<std::uint32_t>(start), payload);
     }
 
     /**
-     * @brief Decides whether the program has reached the end of the source code.
-     *
-     * @returns Whether the program has reached the end of the source code.
-    */
-    bool Lexer::IsAtEnd() const {
-        return current >= sourceCode.size();
+     * @returns The identifier's symbol in the process-wide interner.
+     */
+    std::uint64_t Lexer::Intern(const std::string_view word) {
+        return Interner::Global().Intern(word);
     }
-
 }
@@ -1,68 +1,109 @@
 #pragma once
 #ifndef LEXER_H
 #define LEXER_H
+#include <iterator>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
+#include "arena.h"
+#include "diagnostic.h"
+#include "lineindex.h"
+#include "scanner.h"
+#include "sourcebuffer.h"
 #include "token.h"
+#include "tokenstream.h"
 
 namespace Lexer {
-    class Lexer {
+    class Lexer;
+    class TokenCache;
+
+    /**
+     * @brief Input iterator that pulls tokens from a Lexer one at a time, ending after END_OF_FILE.
+     */
+    class TokenIterator {
+    private:
+        Lexer* lexer = nullptr;
+        std::optional<Token> token;
+    public:
+        using value_type = Token;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::input_iterator_tag;
+
+        TokenIterator() = default;
+        explicit TokenIterator(Lexer& lexer);
+
+        const Token& operator*() const { return *token; }
+        const Token* operator->() const { return &*token; }
+        TokenIterator& operator++();
+        void operator++(int) { ++*this; }
+        bool operator==(std::default_sentinel_t) const { return !token.has_value(); }
+    };
+
+    /**
+     * @brief Lexes source code at run time. The scanning rules themselves are in Scanner, which this supplies with
+     * storage, diagnostics and symbols.
+     */
+    class Lexer : public Scanner<Lexer> {
     private:
-        std::string sourceCode;
-
-        int start = 0;
-        int current = 0;
-
-        int currentLine = 1;
-        int currentChar = 0; // Used for error logging if the programmer makes an error. Shows the exact character.
-        std::vector<Token> tokens;
-
-        // Operators
-        // PLUS, MINUS, MUL, DIV,
-        // EQUAL_TO, LESS, GREATER,
-        // AND, OR, ASSIGN,
-        // // Punctuation
-        // LEFT_PAREN, RIGHT_PAREN,
-        // LEFT_BRACE, RIGHT_BRACE,
-        // COMMA, COLON, SEMICOLON, ARROW,
-
-        // Maps keyword strings to their corresponding TokenType values
-        const std::unordered_map<std::string, TokenType> keywordMap = {
-            // Keywords
-            {"function", TokenType::FUNCTION},
-            {"if",       TokenType::IF},
-            {"else",     TokenType::ELSE},
-            {"else_if",  TokenType::ELSE_IF},
-            {"while",    TokenType::WHILE},
-            {"for",      TokenType::FOR},
-            {"return",   TokenType::RETURN},
-            {"var",      TokenType::VAR},
-
-            // Types
-            {"int",    TokenType::TYPE_INT},
-            {"float",  TokenType::TYPE_FLOAT},
-            {"string", TokenType::TYPE_STRING},
-            {"bool",   TokenType::TYPE_BOOL},
-            {"true", TokenType::BOOL_LITERAL},
-            {"false", TokenType::BOOL_LITERAL},
-        };
+        friend class Scanner<Lexer>;
+
+        SourceBuffer source; // Owns or maps the text that sourceCode views.
+
+        TokenCache* cache = nullptr;
+        std::vector<Diagnostic> diagnostics;
+        mutable std::optional<LineIndex> lineIndex; // Built the first time a location is asked for.
+        std::optional<Token> scannedToken; // Set by Emit while ScanToken runs.
+        std::optional<Token> lookahead; // The token PeekToken has read but NextToken has not handed out yet.
+        Arena localArena; // Used for lexemes when the caller does not supply an arena.
+        Arena* arena; // Backing storage for lexemes that are not a slice of sourceCode, such as decoded string literals.
+
+        // Scanner's callbacks
+        void Emit(TokenType type, std::string_view lexeme, std::uint64_t payload);
+        void Report(const Diagnostic& diagnostic) { diagnostics.push_back(diagnostic); }
+        char* DecodeBuffer(const std::size_t size) { return static_cast<char*>(arena->Allocate(size, 1)); }
+        static std::uint64_t Intern(std::string_view word);
     public:
         // Main Functions
-        explicit Lexer(const std::string& source, bool fromFile);
+        explicit Lexer(const std::string& source, bool fromFile, Arena* arena = nullptr);
+        explicit Lexer(SourceBuffer source, Arena* arena = nullptr);
+        // Tokens hold views into sourceCode, so a Lexer must stay put for as long as its tokens are in use.
+        Lexer(const Lexer&) = delete;
+        Lexer& operator=(const Lexer&) = delete;
+        void Reset(std::string_view source);
         std::vector<Token> Tokenize();
+        void Tokenize(std::vector<Token>& tokens);
+        std::pmr::vector<Token> Tokenize(std::pmr::memory_resource* resource);
+        TokenStream TokenizeStream();
+
+        // Streaming
+        Token NextToken();
+        const Token& PeekToken();
+        TokenIterator begin() { return TokenIterator(*this); }
+        static std::default_sentinel_t end() { return std::default_sentinel; }
+
+        // Positioning, for lexing part of a buffer
+        void Seek(std::size_t position);
+        void Rewind();
+        std::size_t TokenStart() const { return start; }
+        std::size_t Position() const { return current; }
+
+        const std::vector<Diagnostic>& Diagnostics() const { return diagnostics; }
+
+        // Comments are skipped unless asked for, for tooling that needs to see them
+        void KeepComments(const bool keep) { keepComments = keep; }
+
+        // Whole-file Tokenize calls look in the cache first and fill it on a miss. Null turns caching off.
+        void UseCache(TokenCache* tokenCache) { cache = tokenCache; }
+
+        // Locations, resolved lazily
+        SourceLocation Locate(std::uint32_t offset) const;
+        SourceLocation Locate(const Token& token) const { return Locate(token.offset); }
 
         // Helper Functions
         static std::string ConvertSourceToString(const std::string& filePath);
-        void ScanToken();
-        char Advance();
-        void Number();
-        void Identifier();
-        void String();
-        void AddToken(TokenType type, const std::string& lexeme = "");
-        char Peek() const;
-        char PeekNext() const;
-        bool IsAtEnd() const;
+        std::uint32_t CacheOptions() const;
     };
 }
 
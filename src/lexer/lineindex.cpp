@@ -0,0 +1,32 @@
+#include "lineindex.h"
+#include "charscan.h"
+#include <algorithm>
+
+namespace Lexer {
+    /**
+     * @brief Creates the index of an empty source, which has a single line.
+     */
+    LineIndex::LineIndex() : lineStarts{0} {}
+
+    /**
+     * @brief Builds the index by finding every newline in the source.
+     *
+     * @param source The text to index.
+     */
+    LineIndex::LineIndex(const std::string_view source) : LineIndex() {
+        FindLineStarts(source, lineStarts);
+    }
+
+    /**
+     * @brief Resolves a byte offset to a line and column.
+     *
+     * @param offset A byte offset into the indexed source. Offsets past the end resolve to the last line.
+     *
+     * @returns The 1-based line and column of the offset.
+     */
+    SourceLocation LineIndex::Locate(const std::uint32_t offset) const {
+        const auto next = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+        const auto line = static_cast<std::size_t>(next - lineStarts.begin());
+        return {static_cast<int>(line), static_cast<int>(offset - lineStarts[line - 1]) + 1};
+    }
+}
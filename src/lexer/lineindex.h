@@ -0,0 +1,35 @@
+#pragma once
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Lexer {
+    struct SourceLocation {
+        int line; // 1-based.
+        int column; // 1-based, counted in bytes.
+    };
+
+    /**
+     * @brief Maps byte offsets in a source buffer to lines and columns.
+     *
+     * Tokens only record byte offsets, so the lexer never has to track lines while scanning. The index is built in
+     * one vectorized pass over the source the first time a location is actually needed, by a diagnostic or a debugger.
+     */
+    class LineIndex {
+    private:
+        std::vector<std::uint32_t> lineStarts; // Offset of the first byte of each line. lineStarts[0] is always 0.
+    public:
+        LineIndex();
+        explicit LineIndex(std::string_view source);
+
+        SourceLocation Locate(std::uint32_t offset) const;
+        std::size_t LineCount() const { return lineStarts.size(); }
+        std::uint32_t LineStart(int line) const { return lineStarts[static_cast<std::size_t>(line - 1)]; }
+    };
+}
+
+#endif //LINEINDEX_H
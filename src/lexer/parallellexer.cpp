@@ -0,0 +1,297 @@
+#include "parallellexer.h"
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <utility>
+
+#include "charscan.h"
+#include "timetrace.h"
+
+namespace Lexer {
+    /**
+     * @brief Creates a parallel lexer over an already loaded source buffer.
+     *
+     * @param source The buffer holding the source code. The lexer takes ownership of it.
+     * @param chunkSize How many bytes each worker lexes speculatively. Small chunks only pay off on large inputs.
+     */
+    ParallelLexer::ParallelLexer(SourceBuffer source, const std::size_t chunkSize)
+        : source(std::move(source)), chunkSize(chunkSize == 0 ? 1 : chunkSize) {
+        sourceCode = this->source.Text();
+    }
+
+    /**
+     * @brief Creates a parallel lexer the same way Lexer's constructor does.
+     *
+     * @param source The path to the file that contains the source code, or the source code itself.
+     * @param fromFile Whether source is a path to read the code from.
+     * @param chunkSize How many bytes each worker lexes speculatively.
+     *
+     * @throws std::system_error If fromFile is set and the file cannot be opened or read.
+     */
+    ParallelLexer::ParallelLexer(const std::string& source, const bool fromFile, const std::size_t chunkSize)
+        : ParallelLexer(fromFile ? SourceBuffer::FromFile(source) : SourceBuffer::FromString(source), chunkSize) {}
+
+    /**
+     * @brief Lexes the whole source, splitting the work across the pool.
+     *
+     * @param pool The threads to lex the chunks on.
+     *
+     * @returns The same tokens, lexemes and offsets as Lexer::Tokenize on the same source.
+     */
+    std::vector<Token> ParallelLexer::Tokenize(ThreadPool& pool) {
+        lexers.clear();
+        diagnostics.clear();
+        resyncedTokens = 0;
+
+        std::vector<Chunk> chunks = Split();
+        if (chunks.size() <= 1 || pool.Size() == 1) {
+            Lexer& lexer = *lexers.emplace_back(std::make_unique<Lexer>(SourceBuffer::View(sourceCode)));
+            std::vector<Token> tokens = lexer.Tokenize();
+            diagnostics = lexer.Diagnostics();
+            return tokens;
+        }
+
+        // Every task writes into chunks, so all of them must finish before a failure can unwind past it.
+        std::vector<std::future<void>> scanned;
+        scanned.reserve(chunks.size());
+        for (Chunk& chunk : chunks) {
+            scanned.push_back(pool.Submit([this, &chunk] {
+                chunk.exitFromCode = StateAt(LiteralState::CODE, chunk.begin, chunk.end);
+                chunk.exitFromString = StateAt(LiteralState::STRING, chunk.begin, chunk.end);
+            }));
+        }
+        pool.WaitAll(scanned);
+
+        // Chain the chunks' states in order. A cut inside a comment is rare, so that chunk is rescanned here.
+        LiteralState state = LiteralState::CODE;
+        for (Chunk& chunk : chunks) {
+            chunk.entry = state;
+            switch (state) {
+                case LiteralState::CODE: state = chunk.exitFromCode; break;
+                case LiteralState::STRING: state = chunk.exitFromString; break;
+                default: state = StateAt(state, chunk.begin, chunk.end); break;
+            }
+        }
+
+        std::vector<std::future<void>> lexed;
+        lexed.reserve(chunks.size());
+        for (Chunk& chunk : chunks) {
+            Lexer& lexer = *lexers.emplace_back(std::make_unique<Lexer>(SourceBuffer::View(sourceCode)));
+            lexed.push_back(pool.Submit([this, &chunk, &lexer] { LexChunk(chunk, lexer); }));
+        }
+
+        // Waiting through the pool lets a caller that is itself a pool task help with its chunks instead of blocking.
+        pool.WaitAll(lexed);
+
+        std::size_t tokenCount = 0;
+        for (const Chunk& chunk : chunks) tokenCount += chunk.tokens.size();
+
+        std::vector<Token> tokens;
+        tokens.reserve(tokenCount + 1);
+
+        Lexer& resync = *lexers.emplace_back(std::make_unique<Lexer>(SourceBuffer::View(sourceCode)));
+        std::size_t position = 0; // Where the sequential lexer would be after the last token taken so far.
+
+        for (const Chunk& chunk : chunks) {
+            // A token taken from an earlier chunk (a long string, say) may already cover this one.
+            if (position >= chunk.end) continue;
+
+            // Run the real lexer from position until one of its tokens starts where a speculative token does.
+            std::size_t synced = chunk.tokens.size();
+            if (position == chunk.start) {
+                synced = 0;
+            } else {
+                resync.Seek(position);
+                while (true) {
+                    const Token token = resync.NextToken();
+                    if (token.type == TokenType::END_OF_FILE) break;
+
+                    const auto match = std::lower_bound(chunk.tokens.begin(), chunk.tokens.end(), token.offset,
+                                                        [](const Token& speculative, const std::uint32_t offset) {
+                                                            return speculative.offset < offset;
+                                                        });
+                    if (match != chunk.tokens.end() && match->offset == token.offset) {
+                        synced = static_cast<std::size_t>(match - chunk.tokens.begin());
+                        break;
+                    }
+
+                    tokens.push_back(token);
+                    resyncedTokens++;
+                    position = resync.Position();
+                    if (token.offset >= chunk.end) break; // Ran past this chunk without syncing; carry on in the next.
+                }
+            }
+
+            if (synced < chunk.tokens.size()) {
+                tokens.insert(tokens.end(), chunk.tokens.begin() + static_cast<std::ptrdiff_t>(synced), chunk.tokens.end());
+                position = chunk.lastEnd;
+            }
+        }
+
+        tokens.emplace_back(TokenType::END_OF_FILE, "", static_cast<std::uint32_t>(sourceCode.size()));
+        CollectDiagnostics(tokens);
+        return tokens;
+    }
+
+    /**
+     * @brief Keeps the diagnostics that belong to tokens in the final stream, dropping those from discarded guesses.
+     *
+     * A diagnostic records the offset of the token it was found in, and a token starting at a given offset is always
+     * lexed the same way. So any lexer's diagnostic from a token at the offset of a final token is exactly a diagnostic
+     * the sequential lexer would have reported there.
+     *
+     * @param tokens The stitched tokens, in offset order.
+     */
+    void ParallelLexer::CollectDiagnostics(const std::vector<Token>& tokens) {
+        for (const std::unique_ptr<Lexer>& lexer : lexers) {
+            for (const Diagnostic& diagnostic : lexer->Diagnostics()) {
+                const auto token = std::lower_bound(tokens.begin(), tokens.end(), diagnostic.token,
+                                                    [](const Token& candidate, const std::uint32_t offset) {
+                                                        return candidate.offset < offset;
+                                                    });
+                if (token != tokens.end() && token->offset == diagnostic.token) {
+                    diagnostics.push_back(diagnostic);
+                }
+            }
+        }
+
+        // The resync lexer and a chunk's lexer can both have lexed the token where they met.
+        std::sort(diagnostics.begin(), diagnostics.end(), [](const Diagnostic& a, const Diagnostic& b) {
+            return a.offset != b.offset ? a.offset < b.offset : a.kind < b.kind;
+        });
+        diagnostics.erase(std::unique(diagnostics.begin(), diagnostics.end(), [](const Diagnostic& a, const Diagnostic& b) {
+            return a.offset == b.offset && a.kind == b.kind;
+        }), diagnostics.end());
+    }
+
+    /**
+     * @brief Cuts the source into chunks of about chunkSize bytes.
+     *
+     * A cut is moved forward past any '/', '*' or '\\' before it, so it never falls between the two characters of a
+     * comment delimiter or of an escape. The state at a cut is then just code, a string or a comment.
+     *
+     * @returns The chunks, in order and covering the whole source.
+     */
+    std::vector<ParallelLexer::Chunk> ParallelLexer::Split() const {
+        std::vector<Chunk> chunks;
+        for (std::size_t begin = 0; begin < sourceCode.size();) {
+            std::size_t end = std::min(sourceCode.size(), begin + chunkSize);
+            while (end < sourceCode.size() &&
+                   (sourceCode[end - 1] == '/' || sourceCode[end - 1] == '*' || sourceCode[end - 1] == '\\')) {
+                end++;
+            }
+
+            Chunk& chunk = chunks.emplace_back();
+            chunk.begin = begin;
+            chunk.end = end;
+            begin = end;
+        }
+        return chunks;
+    }
+
+    /**
+     * @brief Finds where code resumes, given the state at a position.
+     *
+     * Follows the same rules as the scanner: a backslash in a string takes the next character with it, a line comment
+     * ends at the newline and a block comment after its closing delimiter. Only the bytes up to end are looked at, so
+     * a chunk that is all one long literal is not searched past.
+     *
+     * @param state The state at position.
+     * @param position Where to start looking.
+     * @param end Where to stop looking. It must not follow '/', '*' or '\\' (see Split).
+     *
+     * @returns The first position at or after position that is in code, or end + 1 if code does not resume by end.
+     */
+    std::size_t ParallelLexer::LeaveLiteral(const LiteralState state, std::size_t position, const std::size_t end) const {
+        // The byte at end is needed too: a newline there ends a line comment.
+        const std::string_view text = sourceCode.substr(0, end + 1);
+        const std::size_t stillInside = end + 1;
+
+        switch (state) {
+            case LiteralState::CODE:
+                return position;
+            case LiteralState::STRING:
+                while (true) {
+                    position = FindQuoteOrBackslash(text, position);
+                    if (position >= text.size()) return stillInside;
+                    if (text[position++] == '"') return position;
+                    if (position < text.size()) position++;
+                }
+            case LiteralState::LINE_COMMENT: {
+                const std::size_t newline = text.find('\n', position);
+                return newline == std::string_view::npos ? stillInside : newline;
+            }
+            case LiteralState::BLOCK_COMMENT: {
+                const std::size_t close = text.find("*/", position);
+                return close == std::string_view::npos ? stillInside : close + 2;
+            }
+        }
+        return position;
+    }
+
+    /**
+     * @brief Follows string literals and comments, and nothing else, across part of the source.
+     *
+     * Only a quote or a comment opener can change the state in code, and each is found with memchr, so this runs at
+     * close to memory speed rather than at the speed of the lexer.
+     *
+     * @param state The state at position.
+     * @param position Where to start.
+     * @param end Where to stop. It must not follow '/', '*' or '\\' (see Split).
+     *
+     * @returns The state at end.
+     */
+    ParallelLexer::LiteralState ParallelLexer::StateAt(LiteralState state, std::size_t position, const std::size_t end) const {
+        const std::string_view text = sourceCode.substr(0, end);
+        const auto find = [&text](const char c, const std::size_t from) {
+            const std::size_t found = text.find(c, from);
+            return found == std::string_view::npos ? text.size() : found;
+        };
+
+        std::size_t quote = find('"', position);
+        std::size_t slash = find('/', position);
+        while (true) {
+            if (state != LiteralState::CODE) {
+                position = LeaveLiteral(state, position, end);
+                if (position > end) return state;
+                state = LiteralState::CODE;
+            }
+
+            if (quote < position) quote = find('"', position);
+            if (slash < position) slash = find('/', position);
+            const std::size_t next = std::min(quote, slash);
+            if (next >= end) return LiteralState::CODE;
+
+            position = next + 1;
+            if (next == quote) {
+                state = LiteralState::STRING;
+            } else if (position < sourceCode.size() && (sourceCode[position] == '/' || sourceCode[position] == '*')) {
+                state = sourceCode[position] == '/' ? LiteralState::LINE_COMMENT : LiteralState::BLOCK_COMMENT;
+                position++;
+            }
+        }
+    }
+
+    /**
+     * @brief Lexes one chunk from the first place in it where code resumes.
+     *
+     * The last token may run past the end of the chunk.
+     *
+     * @param chunk The chunk to fill in. Its entry state must be set.
+     * @param lexer A lexer over the whole buffer, used only by this chunk.
+     */
+    void ParallelLexer::LexChunk(Chunk& chunk, Lexer& lexer) const {
+        const TraceScope span("Lex chunk");
+        chunk.start = LeaveLiteral(chunk.entry, chunk.begin, chunk.end);
+        if (chunk.start >= chunk.end) return;
+
+        lexer.Seek(chunk.start);
+        while (true) {
+            const Token token = lexer.NextToken();
+            if (token.type == TokenType::END_OF_FILE || token.offset >= chunk.end) break;
+
+            chunk.tokens.push_back(token);
+            chunk.lastEnd = lexer.Position();
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef PARALLELLEXER_H
+#define PARALLELLEXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "diagnostic.h"
+#include "lexer.h"
+#include "sourcebuffer.h"
+#include "threadpool.h"
+#include "token.h"
+
+namespace Lexer {
+    /**
+     * @brief Lexes one large source buffer on several threads, producing exactly the tokens Lexer::Tokenize would.
+     *
+     * The buffer is cut into chunks of about the same size. A cut can land inside a string literal or comment, and a
+     * chunk lexed from there would see quoting inverted, which does not correct itself. So before lexing, each chunk is
+     * scanned in parallel for nothing but quotes, escapes and comment delimiters, once assuming it starts in code and
+     * once assuming it starts inside a string. Chaining those results in order gives the real state at every cut,
+     * and each chunk is then lexed from the first byte after it where code resumes. That byte may still be inside a
+     * token (an identifier or two-character operator). Cuts never fall right after '/', '*' or '\', so the state at a
+     * cut is never halfway through a delimiter or an escape.
+     *
+     * The chunks are then stitched in order: starting from where the previous chunk's last real token ended, a resync
+     * lexer runs forward until it starts a token at the same offset as one of the chunk's tokens. Lexing is a pure
+     * function of the position at a token boundary, so from that token on the chunk's output is correct and is taken
+     * as-is. With the right entry state this takes a token or two. Tokens only carry byte offsets, so nothing needs
+     * fixing up.
+     */
+    class ParallelLexer {
+    private:
+        // What decides whether a byte is code: the string literal or comment it is in, if any.
+        enum class LiteralState : std::uint8_t { CODE, STRING, LINE_COMMENT, BLOCK_COMMENT };
+
+        struct Chunk {
+            std::size_t begin = 0;
+            std::size_t end = 0;
+            LiteralState exitFromCode = LiteralState::CODE; // The state at end, if the chunk starts in code.
+            LiteralState exitFromString = LiteralState::STRING; // The state at end, if it starts inside a string.
+            LiteralState entry = LiteralState::CODE; // The real state at begin.
+            std::size_t start = 0; // Where code first resumes, which is where lexing the chunk starts.
+            std::vector<Token> tokens;
+            std::size_t lastEnd = 0; // Offset just past the last token.
+        };
+
+        SourceBuffer source;
+        std::string_view sourceCode;
+        std::size_t chunkSize;
+        std::vector<std::unique_ptr<Lexer>> lexers; // Kept alive because tokens may view storage the lexers own.
+        std::vector<Diagnostic> diagnostics;
+        std::size_t resyncedTokens = 0;
+
+        std::vector<Chunk> Split() const;
+        std::size_t LeaveLiteral(LiteralState state, std::size_t position, std::size_t end) const;
+        LiteralState StateAt(LiteralState state, std::size_t position, std::size_t end) const;
+        void CollectDiagnostics(const std::vector<Token>& tokens);
+
+        void LexChunk(Chunk& chunk, Lexer& lexer) const;
+    public:
+        static constexpr std::size_t defaultChunkSize = 4 * 1024 * 1024;
+
+        explicit ParallelLexer(SourceBuffer source, std::size_t chunkSize = defaultChunkSize);
+        ParallelLexer(const std::string& source, bool fromFile, std::size_t chunkSize = defaultChunkSize);
+        ParallelLexer(const ParallelLexer&) = delete;
+        ParallelLexer& operator=(const ParallelLexer&) = delete;
+
+        std::vector<Token> Tokenize(ThreadPool& pool);
+        const std::vector<Diagnostic>& Diagnostics() const { return diagnostics; }
+        std::size_t ResyncedTokens() const { return resyncedTokens; }
+    };
+}
+
+#endif //PARALLELLEXER_H
@@ -0,0 +1,246 @@
+#include "perfcounters.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define VIREO_HAS_PERF_EVENTS 1
+#endif
+
+namespace Lexer {
+    namespace {
+        constexpr const char* phaseNames[] = {"none", "load", "scan", "emit"};
+        constexpr const char* eventNames[] = {"cycles", "instructions", "branch-misses", "L1D-misses", "LLC-misses"};
+
+#if VIREO_HAS_PERF_EVENTS
+        struct EventConfig {
+            std::uint32_t type;
+            std::uint64_t config;
+        };
+
+        constexpr EventConfig CacheReadMisses(const std::uint64_t cache) {
+            return {PERF_TYPE_HW_CACHE, cache | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16};
+        }
+
+        // In PerfEvent order. Cycles comes first because it leads the group.
+        constexpr EventConfig eventConfigs[] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            CacheReadMisses(PERF_COUNT_HW_CACHE_L1D),
+            CacheReadMisses(PERF_COUNT_HW_CACHE_LL),
+        };
+
+        /**
+         * @brief Opens one counter for the calling thread, in user mode only.
+         *
+         * @param event The counter to open.
+         * @param groupFd The group leader, or -1 to open a new, disabled group.
+         *
+         * @returns The counter's file descriptor, or -1 with errno set.
+         */
+        int OpenEvent(const EventConfig& event, const int groupFd) {
+            perf_event_attr attributes{};
+            attributes.size = sizeof(attributes);
+            attributes.type = event.type;
+            attributes.config = event.config;
+            attributes.disabled = groupFd == -1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            attributes.read_format = PERF_FORMAT_GROUP;
+            return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, groupFd, 0));
+        }
+
+        /**
+         * @brief Reads a counter from user space with rdpmc, following the seqlock protocol of perf_event_mmap_page.
+         *
+         * @param mapping The counter's mmapped page.
+         * @param value Receives the counter's value.
+         *
+         * @returns False if rdpmc is not allowed or the counter is not scheduled right now.
+         */
+        bool ReadMapped(const void* mapping, std::uint64_t& value) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+            const auto* page = static_cast<const volatile perf_event_mmap_page*>(mapping);
+            std::uint32_t sequence = 0;
+            do {
+                sequence = page->lock;
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+
+                const std::uint32_t index = page->index;
+                if (!page->cap_user_rdpmc || index == 0) return false;
+
+                // The hardware counter is pmc_width bits wide; sign-extend it before adding the kernel's offset.
+                const unsigned shift = 64 - page->pmc_width;
+                const auto count = static_cast<std::int64_t>(static_cast<std::uint64_t>(__builtin_ia32_rdpmc(index - 1)) << shift) >> shift;
+                value = page->offset + count;
+
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            } while (page->lock != sequence);
+            return true;
+#else
+            static_cast<void>(mapping);
+            static_cast<void>(value);
+            return false;
+#endif
+        }
+#endif
+    }
+
+    /**
+     * @brief Opens the counters for the calling thread and makes them the thread's active set.
+     *
+     * Counters the hardware lacks are left out, as long as cycles can be counted.
+     */
+    PerfCounters::PerfCounters() {
+        fds.fill(-1);
+#if VIREO_HAS_PERF_EVENTS
+        int leader = -1;
+        for (std::size_t event = 0; event < eventCount; ++event) {
+            fds[event] = OpenEvent(eventConfigs[event], leader);
+            if (fds[event] < 0) {
+                if (leader == -1) {
+                    unavailableReason = std::string("perf_event_open failed: ") + std::strerror(errno);
+                    return;
+                }
+                continue;
+            }
+            if (leader == -1) leader = fds[event];
+
+            void* page = mmap(nullptr, static_cast<std::size_t>(sysconf(_SC_PAGESIZE)), PROT_READ, MAP_SHARED, fds[event], 0);
+            pages[event] = page == MAP_FAILED ? nullptr : page;
+        }
+
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        if (!Read(last)) {
+            unavailableReason = "the counters could not be read";
+            return;
+        }
+
+        available = true;
+        previous = current;
+        current = this;
+#else
+        unavailableReason = "hardware counters need Linux perf events";
+#endif
+    }
+
+    PerfCounters::~PerfCounters() {
+        if (current == this) current = previous;
+#if VIREO_HAS_PERF_EVENTS
+        for (std::size_t event = 0; event < eventCount; ++event) {
+            if (pages[event]) munmap(pages[event], static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+            if (fds[event] >= 0) close(fds[event]);
+        }
+#endif
+    }
+
+    /**
+     * @brief Reads every open counter, with rdpmc if it can, otherwise with one read of the whole group.
+     *
+     * @param values Receives each counter's value. Counters that are not open are left alone.
+     *
+     * @returns Whether the counters could be read.
+     */
+    bool PerfCounters::Read(std::array<std::uint64_t, eventCount>& values) const {
+#if VIREO_HAS_PERF_EVENTS
+        bool mapped = true;
+        for (std::size_t event = 0; event < eventCount && mapped; ++event) {
+            if (fds[event] >= 0) mapped = pages[event] && ReadMapped(pages[event], values[event]);
+        }
+        if (mapped) return true;
+
+        // The group read lists the counters in the order they were opened, which skips the missing ones.
+        std::uint64_t buffer[1 + eventCount] = {};
+        if (read(fds[0], buffer, sizeof(buffer)) <= 0) return false;
+
+        std::size_t member = 0;
+        for (std::size_t event = 0; event < eventCount; ++event) {
+            if (fds[event] >= 0 && member < buffer[0]) values[event] = buffer[1 + member++];
+        }
+        return true;
+#else
+        static_cast<void>(values);
+        return false;
+#endif
+    }
+
+    /**
+     * @returns Whether the given counter is open, since not all hardware has every one.
+     */
+    bool PerfCounters::Counting(const PerfEvent event) const {
+        return available && fds[static_cast<std::size_t>(event)] >= 0;
+    }
+
+    /**
+     * @brief Charges the counts since the last switch to the current phase, then enters another.
+     *
+     * @param next The phase to enter.
+     *
+     * @returns The phase that was left, so a scope can return to it.
+     */
+    PerfPhase PerfCounters::Switch(const PerfPhase next) {
+        std::array<std::uint64_t, eventCount> now = last;
+        if (Read(now)) {
+            auto& charged = totals[static_cast<std::size_t>(phase)];
+            for (std::size_t event = 0; event < eventCount; ++event) {
+                charged[event] += now[event] - last[event];
+            }
+            last = now;
+        }
+        return std::exchange(phase, next);
+    }
+
+    /**
+     * @returns How many of the event have been charged to the phase so far.
+     */
+    std::uint64_t PerfCounters::Count(const PerfPhase phase, const PerfEvent event) const {
+        return totals[static_cast<std::size_t>(phase)][static_cast<std::size_t>(event)];
+    }
+
+    /**
+     * @brief Writes a table of each phase's counts, and the same per MB of input.
+     *
+     * @param out Where to write the table.
+     * @param inputBytes How much source was lexed, for the per-MB table. Zero leaves that table out.
+     */
+    void PerfCounters::Report(std::ostream& out, const std::size_t inputBytes) const {
+        if (!available) {
+            out << "hardware counters unavailable: " << unavailableReason << '\n';
+            return;
+        }
+
+        const auto table = [&](const char* title, const double scale) {
+            out << std::left << std::setw(8) << title << std::right;
+            for (const char* name : eventNames) out << std::setw(16) << name;
+            out << std::setw(8) << "IPC" << '\n';
+
+            for (std::size_t phase = 1; phase < phaseCount; ++phase) {
+                out << std::left << std::setw(8) << phaseNames[phase] << std::right;
+                for (std::size_t event = 0; event < eventCount; ++event) {
+                    out << std::setw(16);
+                    if (fds[event] >= 0) out << std::fixed << std::setprecision(0) << totals[phase][event] / scale;
+                    else out << "-";
+                }
+
+                const auto cycles = static_cast<double>(totals[phase][0]);
+                out << std::setw(8) << std::setprecision(2)
+                    << (cycles > 0 ? static_cast<double>(totals[phase][1]) / cycles : 0.0) << '\n';
+            }
+        };
+
+        table("total", 1.0);
+        if (inputBytes > 0) {
+            out << '\n';
+            table("per MB", static_cast<double>(inputBytes) / 1e6);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace Lexer {
+    enum class PerfPhase {
+        NONE, // Outside every instrumented phase. Counted, but not reported.
+        LOAD, // Reading or mapping the source file.
+        SCAN, // ScanToken, less the time spent emitting.
+        EMIT // AddToken.
+    };
+
+    enum class PerfEvent { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES };
+
+    /**
+     * @brief Hardware performance counters for the calling thread, split by lexer phase.
+     *
+     * On Linux the counters are opened as one perf_event_open group, so they are scheduled together, and read with
+     * rdpmc where the kernel allows it (a read of the group otherwise). Construction makes this the calling thread's
+     * active set, which the phase hooks charge. The hooks are only compiled in when VIREO_PERF_COUNTERS is defined, so
+     * a normal build pays nothing for them.
+     *
+     * Where counters cannot be opened (another platform, a virtual machine without a PMU, a strict
+     * perf_event_paranoid) Available is false, the hooks do nothing and Report says why.
+     */
+    class PerfCounters {
+    public:
+        static constexpr std::size_t eventCount = 5;
+        static constexpr std::size_t phaseCount = 4;
+    private:
+        static inline thread_local PerfCounters* current = nullptr;
+
+        std::array<int, eventCount> fds{};
+        std::array<void*, eventCount> pages{}; // The mmapped perf_event_mmap_page of each counter, for rdpmc.
+        std::array<std::array<std::uint64_t, eventCount>, phaseCount> totals{};
+        std::array<std::uint64_t, eventCount> last{};
+        PerfPhase phase = PerfPhase::NONE;
+        PerfCounters* previous = nullptr;
+        bool available = false;
+        std::string unavailableReason;
+
+        bool Read(std::array<std::uint64_t, eventCount>& values) const;
+    public:
+        PerfCounters();
+        ~PerfCounters();
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        static PerfCounters* Current() { return current; }
+
+        bool Available() const { return available; }
+        bool Counting(PerfEvent event) const;
+        PerfPhase Switch(PerfPhase next);
+        std::uint64_t Count(PerfPhase phase, PerfEvent event) const;
+        void Report(std::ostream& out, std::size_t inputBytes) const;
+    };
+
+    /**
+     * @brief Charges what runs during its lifetime to a phase of the calling thread's counters, if there are any.
+     */
+    class PerfScope {
+    private:
+        PerfCounters* counters;
+        PerfPhase previous = PerfPhase::NONE;
+    public:
+        explicit PerfScope(const PerfPhase phase) : counters(PerfCounters::Current()) {
+            if (counters) previous = counters->Switch(phase);
+        }
+
+        ~PerfScope() {
+            if (counters) counters->Switch(previous);
+        }
+
+        PerfScope(const PerfScope&) = delete;
+        PerfScope& operator=(const PerfScope&) = delete;
+    };
+}
+
+// Marks the rest of the enclosing block as a lexer phase. Expands to nothing unless VIREO_PERF_COUNTERS is defined.
+#ifdef VIREO_PERF_COUNTERS
+#define VIREO_PERF_PHASE(phase) const ::Lexer::PerfScope vireoPerfScope(::Lexer::PerfPhase::phase)
+#else
+#define VIREO_PERF_PHASE(phase) static_cast<void>(0)
+#endif
+
+#endif //PERFCOUNTERS_H
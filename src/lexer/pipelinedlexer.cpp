@@ -0,0 +1,80 @@
+#include "pipelinedlexer.h"
+#include <utility>
+
+namespace Lexer {
+    /**
+     * @brief Starts lexing from the beginning of the source on a new thread.
+     *
+     * The lexer belongs to the pipeline's thread until the pipeline is destroyed, and must outlive it, since the tokens
+     * view its source.
+     *
+     * @param lexer The lexer to run.
+     * @param batchSize How many tokens go in each batch. The last batch may be shorter.
+     * @param depth How many batches may wait for the consumer before the lexer pauses. Rounded up to a power of two.
+     */
+    PipelinedLexer::PipelinedLexer(Lexer& lexer, const std::size_t batchSize, const std::size_t depth)
+        : lexer(lexer), batchSize(batchSize == 0 ? 1 : batchSize), filled(depth), recycled(filled.Capacity() + 2),
+          producer([this](const std::stop_token stop) { Produce(stop); }) {}
+
+    /**
+     * @brief Stops the lexer thread, even if the consumer did not read every batch.
+     */
+    PipelinedLexer::~PipelinedLexer() {
+        producer.request_stop();
+
+        // Taking batches wakes a lexer that is waiting for room, so it can see the stop request.
+        std::vector<Token> discarded;
+        while (!producerDone.load(std::memory_order_acquire)) {
+            if (!filled.TryPop(discarded)) std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief Waits for the next batch of tokens.
+     *
+     * The previous batch is handed back for reuse, so views of it must not be kept across calls.
+     *
+     * @returns The next batch, the last of which ends with END_OF_FILE, then an empty span.
+     */
+    std::span<const Token> PipelinedLexer::NextBatch() {
+        if (!current.empty()) {
+            recycled.TryPush(current);
+            current.clear();
+        }
+        if (finished) return {};
+
+        while (!filled.TryPop(current)) {
+            filled.WaitForItems();
+        }
+        finished = current.back().type == TokenType::END_OF_FILE;
+        return current;
+    }
+
+    /**
+     * @brief The lexer thread: fills batches until END_OF_FILE or a stop request.
+     */
+    void PipelinedLexer::Produce(const std::stop_token stop) {
+        lexer.Rewind();
+
+        bool atEnd = false;
+        while (!atEnd && !stop.stop_requested()) {
+            std::vector<Token> batch;
+            if (recycled.TryPop(batch)) {
+                batch.clear();
+            } else {
+                batch.reserve(batchSize);
+            }
+
+            while (batch.size() < batchSize && !atEnd) {
+                batch.push_back(lexer.NextToken());
+                atEnd = batch.back().type == TokenType::END_OF_FILE;
+            }
+
+            while (!filled.TryPush(batch) && !stop.stop_requested()) {
+                filled.WaitForSpace();
+            }
+        }
+
+        producerDone.store(true, std::memory_order_release);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef PIPELINEDLEXER_H
+#define PIPELINEDLEXER_H
+
+#include <atomic>
+#include <cstddef>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "lexer.h"
+#include "spscring.h"
+#include "token.h"
+
+namespace Lexer {
+    /**
+     * @brief Runs a lexer on a thread of its own and hands its tokens to a consumer in fixed-size batches.
+     *
+     * The consumer (a parser, a highlighter, an indexer) can start on the first batch while the rest of the file is
+     * still being lexed. Batches travel through a lock-free single-producer/single-consumer ring, and the vectors are
+     * sent back through a second ring once consumed. At most depth batches are in flight, which caps the memory in use
+     * whatever the size of the file, and once the vectors have been recycled the steady state does not allocate.
+     */
+    class PipelinedLexer {
+    private:
+        Lexer& lexer;
+        std::size_t batchSize;
+        SpscRing<std::vector<Token>> filled; // Lexer to consumer.
+        SpscRing<std::vector<Token>> recycled; // Consumer back to lexer, so batch vectors are reused.
+        std::vector<Token> current; // The batch the consumer is holding.
+        bool finished = false; // The consumer has been handed END_OF_FILE.
+        std::atomic<bool> producerDone = false;
+        std::jthread producer; // Last, so it starts once everything it uses is constructed.
+
+        void Produce(std::stop_token stop);
+    public:
+        static constexpr std::size_t defaultBatchSize = 1024;
+        static constexpr std::size_t defaultDepth = 8;
+
+        explicit PipelinedLexer(Lexer& lexer, std::size_t batchSize = defaultBatchSize, std::size_t depth = defaultDepth);
+        ~PipelinedLexer();
+
+        PipelinedLexer(const PipelinedLexer&) = delete;
+        PipelinedLexer& operator=(const PipelinedLexer&) = delete;
+
+        std::span<const Token> NextBatch();
+    };
+}
+
+#endif //PIPELINEDLEXER_H
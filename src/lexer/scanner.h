@@ -0,0 +1,553 @@
+#pragma once
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include "charscan.h"
+#include "diagnostic.h"
+#include "keywords.h"
+#include "scantables.h"
+#include "tokentype.h"
+#include "unicode.h"
+
+namespace Lexer {
+    namespace ScanHelpers {
+        // ASCII-only character test. Unlike <cctype> it ignores the locale and is safe for any char value.
+        constexpr bool IsDigit(const char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        // Finds the end of a run of bytes that do not start a valid UTF-8 sequence, so a run becomes one token.
+        constexpr std::size_t SkipInvalidUtf8(const std::string_view text, std::size_t position) {
+            std::uint32_t codePoint = 0;
+            do {
+                position++;
+            } while (position < text.size() && DecodeUtf8(text, position, codePoint) == 0);
+            return position;
+        }
+
+        /**
+         * @brief Parses a run of decimal digits, for constant evaluation, where std::from_chars is not available.
+         *
+         * @returns False if the value does not fit in 64 bits.
+         */
+        constexpr bool ParseInteger(const std::string_view digits, std::int64_t& value) {
+            std::uint64_t result = 0;
+            for (const char c : digits) {
+                const auto digit = static_cast<std::uint64_t>(c - '0');
+                if (result > (static_cast<std::uint64_t>(INT64_MAX) - digit) / 10) return false;
+                result = result * 10 + digit;
+            }
+            value = static_cast<std::int64_t>(result);
+            return true;
+        }
+
+        // Deliberately not constexpr: reaching it during constant evaluation stops compilation, naming the problem.
+        inline void FloatLiteralNeedsRuntimeParsing() {}
+
+        /**
+         * @brief Parses digits.digits for constant evaluation, rounded exactly as std::from_chars would.
+         *
+         * Only Clinger's fast path is taken: when the digits without the point fit in 53 bits and there are at most
+         * 22 after it, both the integer and the power of ten are exact doubles and one division rounds correctly.
+         * Anything else cannot be parsed exactly here and stops compilation.
+         */
+        constexpr double ParseFloat(const std::string_view text) {
+            constexpr double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+            constexpr std::uint64_t maxExact = std::uint64_t{1} << 53;
+
+            std::uint64_t mantissa = 0;
+            std::size_t fractionDigits = 0;
+            bool fraction = false;
+            for (const char c : text) {
+                if (c == '.') {
+                    fraction = true;
+                    continue;
+                }
+                if (mantissa > (maxExact - static_cast<std::uint64_t>(c - '0')) / 10) {
+                    FloatLiteralNeedsRuntimeParsing();
+                    return 0;
+                }
+                mantissa = mantissa * 10 + static_cast<std::uint64_t>(c - '0');
+                fractionDigits += fraction;
+            }
+
+            if (fractionDigits >= std::size(powersOfTen)) {
+                FloatLiteralNeedsRuntimeParsing();
+                return 0;
+            }
+            return static_cast<double>(mantissa) / powersOfTen[fractionDigits];
+        }
+
+        /**
+         * @brief Parses the hex digits of a \u{...} escape.
+         *
+         * @returns False if there are none, more than six, or something other than hex digits.
+         */
+        constexpr bool ParseHexCodePoint(const std::string_view digits, std::uint32_t& codePoint) {
+            if (digits.empty() || digits.size() > 6) return false;
+
+            codePoint = 0;
+            for (const char c : digits) {
+                std::uint32_t digit = 0;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                else return false;
+                codePoint = codePoint << 4 | digit;
+            }
+            return true;
+        }
+    }
+
+    /**
+     * @brief The token scanner: every rule for where a token ends and what its value is.
+     *
+     * It is constexpr, so the runtime Lexer and compile-time tokenization share one implementation. What differs
+     * between them is supplied by Derived, which the scanner calls back (CRTP):
+     *  - Emit(type, lexeme, payload) receives each token,
+     *  - Report(diagnostic) receives each problem,
+     *  - DecodeBuffer(size) provides room for a string literal's decoded escapes,
+     *  - Intern(word) gives an identifier its symbol.
+     *
+     * Where the runtime has a faster route that constant evaluation cannot take (the SIMD kernels, std::from_chars),
+     * std::is_constant_evaluated picks the scalar one, and the branch folds away in each instantiation.
+     */
+    template <typename Derived>
+    class Scanner {
+    protected:
+        std::string_view sourceCode; // View of the text being scanned.
+        std::size_t start = 0;
+        std::size_t current = 0;
+        bool keepComments = false;
+
+        constexpr Scanner() = default;
+        constexpr explicit Scanner(const std::string_view source) : sourceCode(source) {}
+    public:
+        constexpr void ScanToken();
+        constexpr char Advance();
+        constexpr void AdvanceTo(std::size_t position);
+        constexpr void SkipWhitespaceRun();
+        constexpr void Number();
+        constexpr void Identifier();
+        constexpr void NonAscii();
+        constexpr void Punctuator(char first);
+        constexpr void Comment();
+        constexpr void String();
+        constexpr std::string_view DecodeEscapes(std::string_view raw);
+        constexpr void CheckUtf8(std::size_t from, std::size_t to);
+        constexpr void AddToken(TokenType type);
+        constexpr void AddToken(TokenType type, std::string_view lexeme, std::uint64_t payload = 0);
+        constexpr void AddDiagnostic(DiagnosticKind kind);
+        constexpr char Peek() const;
+        constexpr char PeekNext() const;
+        constexpr bool IsAtEnd() const;
+    private:
+        constexpr Derived& Self() { return static_cast<Derived&>(*this); }
+    };
+
+    /**
+     * @brief Scans the current token to check if it is a possible token.
+     *
+     * The first character picks the action from a table generated out of tokenSpecs, so there is no per-operator
+     * branching here.
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::ScanToken() {
+        const char c = Advance();
+        switch (ScanTables::dfa.actions[static_cast<unsigned char>(c)]) {
+            case ScanAction::WHITESPACE: SkipWhitespaceRun(); break;
+            case ScanAction::NUMBER: Number(); break;
+            case ScanAction::IDENTIFIER: Identifier(); break;
+            case ScanAction::STRING: String(); break;
+            case ScanAction::PUNCTUATOR: Punctuator(c); break;
+            case ScanAction::NON_ASCII: NonAscii(); break;
+            case ScanAction::SLASH:
+                if (Peek() == '/' || Peek() == '*') Comment();
+                else Punctuator(c);
+                break;
+            case ScanAction::UNKNOWN: AddToken(TokenType::UNKNOWN); break;
+        }
+    }
+
+    /**
+     * @brief Runs the punctuator DFA from the character just consumed and adds the longest punctuator it matched.
+     *
+     * A lone prefix with no punctuator of its own, such as a single '&', becomes a one-character UNKNOWN token.
+     *
+     * @param first The character that started the punctuator.
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::Punctuator(const char first) {
+        const ScanTables::Dfa& dfa = ScanTables::dfa;
+
+        std::uint8_t state = dfa.Next(ScanTables::START, first);
+        TokenType accepted = dfa.accepts[state];
+        std::size_t acceptedEnd = current;
+
+        for (std::uint8_t next = dfa.Next(state, Peek()); next != ScanTables::DEAD; next = dfa.Next(state, Peek())) {
+            Advance();
+            state = next;
+            if (dfa.accepts[state] != TokenType::UNKNOWN) {
+                accepted = dfa.accepts[state];
+                acceptedEnd = current;
+            }
+        }
+
+        // Give back anything read past the longest match.
+        current = acceptedEnd;
+
+        AddToken(accepted);
+    }
+
+    /**
+     * @brief Advances the current character that the source code is on.
+     *
+     * @returns The character that it just passed.
+    */
+    template <typename Derived>
+    constexpr char Scanner<Derived>::Advance() {
+        return sourceCode[current++];  // Read current, then advance
+    }
+
+    /**
+     * @brief Moves past a run of characters that has already been scanned.
+     *
+     * @param position The index of the first character after the run.
+     */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::AdvanceTo(const std::size_t position) {
+        current = position;
+    }
+
+    /**
+     * @brief Skips a line or block comment, or adds it as a COMMENT token if comments are being kept.
+     *
+     * The end is found with string_view::find, which is memchr at run time (for a line comment's newline, or each '*'
+     * that may close a block comment) rather than advancing a character at a time. Lines are resolved from byte
+     * offsets, so nothing needs counting here.
+     *
+     * A comment's text is only checked for invalid UTF-8 when it becomes a token: when comments are kept, or when a
+     * block comment is unterminated. A skipped comment reaches nobody, so it keeps the memchr fast path and gets no
+     * diagnostics, which would otherwise point at a token the stream does not have.
+     */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::Comment() {
+        const std::size_t body = current + 1;
+        if (Advance() == '/') {
+            const std::size_t newline = sourceCode.find('\n', current);
+            AdvanceTo(newline == std::string_view::npos ? sourceCode.size() : newline);
+            if (keepComments) CheckUtf8(body, current);
+        } else {
+            const std::size_t close = sourceCode.find("*/", current);
+            if (close == std::string_view::npos) {
+                AdvanceTo(sourceCode.size());
+                CheckUtf8(body, current);
+                AddDiagnostic(DiagnosticKind::UNTERMINATED_COMMENT);
+                AddToken(TokenType::UNKNOWN);
+                return;
+            }
+            AdvanceTo(close + 2);
+            if (keepComments) CheckUtf8(body, close);
+        }
+
+        if (keepComments) {
+            AddToken(TokenType::COMMENT);
+        }
+    }
+
+    /**
+     * @brief Skips the rest of a whitespace run in one step.
+     */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::SkipWhitespaceRun() {
+        if (std::is_constant_evaluated()) AdvanceTo(Scalar::SkipWhitespace(sourceCode, current));
+        else AdvanceTo(SkipWhitespace(sourceCode, current));
+    }
+
+    /**
+     * @brief Read digits in the source code to form an integer or float literal, decoding its value.
+     *
+     * Integers that do not fit in 64 bits and floats too large for a double get a diagnostic and a value of zero.
+     */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::Number() {
+        const auto skipDigits = [this] {
+            if (std::is_constant_evaluated()) AdvanceTo(Scalar::SkipDigits(sourceCode, current));
+            else AdvanceTo(SkipDigits(sourceCode, current));
+        };
+        skipDigits();
+
+        if (Peek() == '.' && ScanHelpers::IsDigit(PeekNext())) {
+            Advance();
+            skipDigits();
+
+            // libstdc++ parses doubles with the Eisel-Lemire algorithm, so this is a handful of multiplications.
+            const std::string_view text = sourceCode.substr(start, current - start);
+            double value = 0;
+            if (std::is_constant_evaluated()) {
+                value = ScanHelpers::ParseFloat(text);
+            } else if (std::from_chars(text.data(), text.data() + text.size(), value).ec != std::errc()) {
+                AddDiagnostic(DiagnosticKind::FLOAT_OUT_OF_RANGE);
+                value = 0;
+            }
+
+            AddToken(TokenType::FLOAT_LITERAL, text, std::bit_cast<std::uint64_t>(value));
+        } else {
+            const std::string_view text = sourceCode.substr(start, current - start);
+            std::int64_t value = 0;
+            const bool parsed = std::is_constant_evaluated()
+                ? ScanHelpers::ParseInteger(text, value)
+                : std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc();
+            if (!parsed) {
+                AddDiagnostic(DiagnosticKind::INTEGER_OVERFLOW);
+                value = 0;
+            }
+
+            AddToken(TokenType::INT_LITERAL, text, static_cast<std::uint64_t>(value));
+        }
+    }
+
+    /**
+     * @brief Read the source code as long as characters are letters, digits, or underscores and add a token identifier
+     *
+     * Beyond ASCII, any code point with the XID_Continue property continues an identifier.
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::Identifier() {
+        while (true) {
+            if (std::is_constant_evaluated()) AdvanceTo(Scalar::SkipIdentifierChars(sourceCode, current));
+            else AdvanceTo(SkipIdentifierChars(sourceCode, current));
+
+            // The ASCII run stops at any byte of 0x80 and above; only then is it worth decoding what comes next.
+            if (static_cast<unsigned char>(Peek()) < 0x80) break;
+
+            std::uint32_t codePoint = 0;
+            const std::size_t length = DecodeUtf8(sourceCode, current, codePoint);
+            if (length == 0 || !IsXidContinue(codePoint)) break;
+            AdvanceTo(current + length);
+        }
+
+        const std::string_view word = sourceCode.substr(start, current - start);
+
+        if (const TokenType keyword = LookupKeyword(word); keyword == TokenType::BOOL_LITERAL) {
+            AddToken(keyword, word, word == "true");
+        } else if (keyword != TokenType::IDENTIFIER) {
+            AddToken(keyword);
+        } else {
+            AddToken(TokenType::IDENTIFIER, word, Self().Intern(word));
+        }
+    }
+
+    /**
+     * @brief Scans a token that starts with a byte of 0x80 or above.
+     *
+     * A code point with the XID_Start property starts an identifier. Any other code point becomes a single UNKNOWN
+     * token however many bytes it takes, and a run of invalid UTF-8 becomes one UNKNOWN token with a diagnostic.
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::NonAscii() {
+        std::uint32_t codePoint = 0;
+        const std::size_t length = DecodeUtf8(sourceCode, start, codePoint);
+
+        if (length == 0) {
+            AdvanceTo(ScanHelpers::SkipInvalidUtf8(sourceCode, start));
+            AddDiagnostic(DiagnosticKind::INVALID_UTF8);
+            AddToken(TokenType::UNKNOWN);
+            return;
+        }
+
+        AdvanceTo(start + length);
+        if (IsXidStart(codePoint)) {
+            Identifier();
+        } else {
+            AddToken(TokenType::UNKNOWN);
+        }
+    }
+
+    /**
+     * @brief Extracts a string literal from a pair of double quotes.
+     *
+     * The closing quote is found with a vectorized search for the next '"' or '\\', so long literals are crossed a block
+     * at a time. A literal without escapes is viewed in place; only one with escapes is decoded, into DecodeBuffer.
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::String() {
+        bool escaped = false;
+
+        for (;;) {
+            if (std::is_constant_evaluated()) AdvanceTo(Scalar::FindQuoteOrBackslash(sourceCode, current));
+            else AdvanceTo(FindQuoteOrBackslash(sourceCode, current));
+
+            if (IsAtEnd()) {
+                CheckUtf8(start + 1, current);
+                AddDiagnostic(DiagnosticKind::UNTERMINATED_STRING);
+                AddToken(TokenType::UNKNOWN);
+                return;
+            }
+
+            if (Advance() == '"') break;
+
+            // A backslash always takes the next character with it, so an escaped quote cannot end the literal.
+            escaped = true;
+            if (!IsAtEnd()) Advance();
+        }
+
+        CheckUtf8(start + 1, current - 1);
+        const std::string_view raw = sourceCode.substr(start + 1, current - start - 2);
+        AddToken(TokenType::STRING_LITERAL, escaped ? DecodeEscapes(raw) : raw);
+    }
+
+    /**
+     * @brief Reports every run of invalid UTF-8 in part of the token being scanned.
+     *
+     * Mostly ASCII text is checked a block at a time, so a string literal with no multibyte characters costs one pass.
+     *
+     * @param from Where to start checking. Must be at the start of a sequence.
+     * @param to Where to stop.
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::CheckUtf8(const std::size_t from, const std::size_t to) {
+        const std::string_view text = sourceCode.substr(0, to);
+        const auto findInvalid = [&text](const std::size_t position) {
+            return std::is_constant_evaluated() ? Scalar::FindInvalidUtf8(text, position) : FindInvalidUtf8(text, position);
+        };
+
+        for (std::size_t invalid = findInvalid(from); invalid < to;) {
+            const std::size_t end = ScanHelpers::SkipInvalidUtf8(text, invalid);
+            Self().Report({DiagnosticKind::INVALID_UTF8, static_cast<std::uint32_t>(invalid),
+                           static_cast<std::uint32_t>(end - invalid), static_cast<std::uint32_t>(start)});
+            invalid = findInvalid(end);
+        }
+    }
+
+    /**
+     * @brief Decodes the escape sequences in a string literal's contents into storage from DecodeBuffer.
+     *
+     * Supports \n, \t, \\, \" and \u{hex}, which is written out as UTF-8. An invalid escape gets a diagnostic and
+     * is kept as written.
+     *
+     * @param raw The text between the quotes, as it appears in the source.
+     *
+     * @returns A view of the decoded text, valid for as long as that storage.
+    */
+    template <typename Derived>
+    constexpr std::string_view Scanner<Derived>::DecodeEscapes(const std::string_view raw) {
+        // No escape decodes to more bytes than it is written with, so the raw size is always enough.
+        char* const decoded = Self().DecodeBuffer(raw.size());
+        std::size_t length = 0;
+
+        for (std::size_t i = 0; i < raw.size(); ++i) {
+            if (raw[i] != '\\' || i + 1 == raw.size()) {
+                decoded[length++] = raw[i];
+                continue;
+            }
+
+            switch (raw[i + 1]) {
+                case 'n': decoded[length++] = '\n'; ++i; continue;
+                case 't': decoded[length++] = '\t'; ++i; continue;
+                case '\\': decoded[length++] = '\\'; ++i; continue;
+                case '"': decoded[length++] = '"'; ++i; continue;
+                case 'u': {
+                    const std::size_t close = raw.find('}', i);
+                    if (i + 2 >= raw.size() || raw[i + 2] != '{' || close == std::string_view::npos) break;
+
+                    // Only Unicode scalar values: nothing past U+10FFFF and no surrogates.
+                    std::uint32_t codePoint = 0;
+                    if (close > i + 3 && ScanHelpers::ParseHexCodePoint(raw.substr(i + 3, close - i - 3), codePoint) &&
+                        codePoint <= 0x10FFFF && (codePoint < 0xD800 || codePoint > 0xDFFF)) {
+                        length += EncodeUtf8(codePoint, decoded + length);
+                        i = close;
+                        continue;
+                    }
+                    break;
+                }
+                default: break;
+            }
+
+            Self().Report({DiagnosticKind::INVALID_ESCAPE, static_cast<std::uint32_t>(start + 1 + i), 2,
+                           static_cast<std::uint32_t>(start)});
+            decoded[length++] = raw[i];
+        }
+
+        return {decoded, length};
+    }
+
+    /**
+     * @brief Hands a token to Derived.
+     *
+     * The lexeme is the text between start and current, viewed directly from the source buffer.
+     *
+     * @param type The type of token to add
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::AddToken(const TokenType type) {
+        AddToken(type, sourceCode.substr(start, current - start));
+    }
+
+    /**
+     * @brief Adds a token whose lexeme is an explicit view, such as a slice of the source buffer.
+     *
+     * @param type The type of token to add
+     * @param lexeme A view that must outlive the token, normally into sourceCode.
+     * @param payload The token's decoded value, if its type has one.
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::AddToken(const TokenType type, const std::string_view lexeme,
+                                              const std::uint64_t payload) {
+        Self().Emit(type, lexeme, payload);
+    }
+
+    /**
+     * @brief Records a problem with the token being scanned.
+     *
+     * @param kind What is wrong with it.
+    */
+    template <typename Derived>
+    constexpr void Scanner<Derived>::AddDiagnostic(const DiagnosticKind kind) {
+        Self().Report({kind, static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(current - start),
+                       static_cast<std::uint32_t>(start)});
+    }
+
+    /**
+     * @brief Checks the current character.
+     *
+     * @returns The next character that the lexer will read.
+     */
+    template <typename Derived>
+    constexpr char Scanner<Derived>::Peek() const {
+        if (current >= sourceCode.size()) return '\0';
+        return sourceCode[current];
+    }
+
+    /**
+     * @brief Shows the next character that is waiting in the queue.
+     *
+     * @return The next character in the queue.
+    */
+    template <typename Derived>
+    constexpr char Scanner<Derived>::PeekNext() const {
+        if (current + 1 >= sourceCode.size()) return '\0';
+        return sourceCode[current + 1];
+    }
+
+    /**
+     * @brief Decides whether the program has reached the end of the source code.
+     *
+     * @returns Whether the program has reached the end of the source code.
+    */
+    template <typename Derived>
+    constexpr bool Scanner<Derived>::IsAtEnd() const {
+        return current >= sourceCode.size();
+    }
+}
+
+#endif //SCANNER_H
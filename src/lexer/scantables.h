@@ -0,0 +1,94 @@
+#pragma once
+#ifndef SCANTABLES_H
+#define SCANTABLES_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "tokenspec.h"
+
+namespace Lexer {
+    /**
+     * @brief What ScanToken does with the first character of a token.
+     */
+    enum class ScanAction : std::uint8_t {
+        UNKNOWN, WHITESPACE, NUMBER, IDENTIFIER, STRING, PUNCTUATOR, NON_ASCII,
+        SLASH // Division, or the start of a comment.
+    };
+
+    /**
+     * @brief Character-class and transition tables for the scanner, generated at compile time from tokenSpecs.
+     *
+     * Punctuators are recognised by a DFA whose states are the prefixes of every punctuator spelling, so two-character
+     * operators such as "->" and "==" are just longer paths through the same table. Bytes that never appear in a
+     * punctuator share one character class, which keeps the transition table small enough to stay in L1.
+     */
+    namespace ScanTables {
+        inline constexpr std::uint8_t START = 0;
+        inline constexpr std::uint8_t DEAD = 0; // No transition ever leads back to the start state, so 0 doubles as "no transition".
+
+        inline constexpr std::size_t punctuatorBytes = [] {
+            std::size_t total = 0;
+            for (const TokenSpec& spec : tokenSpecs) {
+                if (spec.kind == TokenKind::PUNCTUATOR) total += spec.spelling.size();
+            }
+            return total;
+        }();
+
+        inline constexpr std::size_t maxStates = punctuatorBytes + 1;
+        inline constexpr std::size_t maxClasses = punctuatorBytes + 1;
+        static_assert(maxStates <= 256, "Punctuator DFA states must fit in a byte.");
+
+        struct Dfa {
+            std::array<ScanAction, 256> actions{};
+            std::array<std::uint8_t, 256> byteClasses{}; // Class 0 is every byte that is not part of a punctuator.
+            std::array<std::array<std::uint8_t, maxClasses>, maxStates> transitions{};
+            std::array<TokenType, maxStates> accepts{}; // TokenType::UNKNOWN for states that are only a prefix.
+            std::size_t stateCount = 1;
+
+            constexpr std::uint8_t Next(const std::uint8_t state, const char c) const {
+                return transitions[state][byteClasses[static_cast<unsigned char>(c)]];
+            }
+        };
+
+        constexpr Dfa BuildDfa() {
+            Dfa dfa;
+            std::size_t classCount = 1;
+
+            for (TokenType& accept : dfa.accepts) accept = TokenType::UNKNOWN;
+
+            for (const TokenSpec& spec : tokenSpecs) {
+                if (spec.kind != TokenKind::PUNCTUATOR) continue;
+
+                std::uint8_t state = START;
+                for (const char c : spec.spelling) {
+                    std::uint8_t& byteClass = dfa.byteClasses[static_cast<unsigned char>(c)];
+                    if (byteClass == 0) byteClass = static_cast<std::uint8_t>(classCount++);
+
+                    std::uint8_t& next = dfa.transitions[state][byteClass];
+                    if (next == DEAD) next = static_cast<std::uint8_t>(dfa.stateCount++);
+                    state = next;
+                }
+                dfa.accepts[state] = spec.type;
+            }
+
+            for (std::size_t c = 0; c < dfa.actions.size(); c++) {
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') dfa.actions[c] = ScanAction::WHITESPACE;
+                else if (c >= '0' && c <= '9') dfa.actions[c] = ScanAction::NUMBER;
+                else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') dfa.actions[c] = ScanAction::IDENTIFIER;
+                else if (c == '"') dfa.actions[c] = ScanAction::STRING;
+                else if (c == '/') dfa.actions[c] = ScanAction::SLASH;
+                else if (dfa.transitions[START][dfa.byteClasses[c]] != DEAD) dfa.actions[c] = ScanAction::PUNCTUATOR;
+                else if (c >= 0x80) dfa.actions[c] = ScanAction::NON_ASCII;
+                else dfa.actions[c] = ScanAction::UNKNOWN;
+            }
+
+            return dfa;
+        }
+
+        inline constexpr Dfa dfa = BuildDfa();
+    }
+}
+
+#endif //SCANTABLES_H
@@ -0,0 +1,184 @@
+#include "sourcebuffer.h"
+#include "perfcounters.h"
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define VIREO_HAS_MMAP 1
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+namespace Lexer {
+    namespace {
+#if VIREO_HAS_MMAP
+        /**
+         * @brief Closes a file descriptor when it goes out of scope.
+         */
+        struct FileDescriptor {
+            int fd;
+
+            explicit FileDescriptor(const int fd) : fd(fd) {}
+            ~FileDescriptor() { if (fd >= 0) close(fd); }
+        };
+
+        /**
+         * @brief Reads everything remaining in a file descriptor. Used for pipes and files that cannot be mapped.
+         */
+        std::string ReadAll(const int fd, const std::string& filePath) {
+            std::string text;
+            char block[64 * 1024];
+
+            while (true) {
+                const ssize_t count = read(fd, block, sizeof(block));
+                if (count == 0) break;
+                if (count < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::system_error(errno, std::generic_category(), "Could not read source file '" + filePath + "'");
+                }
+                text.append(block, static_cast<std::size_t>(count));
+            }
+
+            return text;
+        }
+#endif
+    }
+
+    SourceBuffer::~SourceBuffer() {
+        Unmap();
+    }
+
+    SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept
+        : storage(other.storage), owned(std::move(other.owned)), externalData(other.externalData), externalSize(other.externalSize) {
+        other.storage = Storage::OWNED;
+        other.externalData = nullptr;
+        other.externalSize = 0;
+    }
+
+    SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept {
+        if (this != &other) {
+            Unmap();
+            storage = std::exchange(other.storage, Storage::OWNED);
+            owned = std::move(other.owned);
+            externalData = std::exchange(other.externalData, nullptr);
+            externalSize = std::exchange(other.externalSize, 0);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Creates a buffer that owns an in-memory copy of the source code.
+     *
+     * @param text The source code.
+     */
+    SourceBuffer SourceBuffer::FromString(std::string text) {
+        SourceBuffer buffer;
+        buffer.owned = std::move(text);
+        return buffer;
+    }
+
+    /**
+     * @brief Loads a source file, memory-mapping it when possible.
+     *
+     * @param filePath The path to the file that contains the source code.
+     *
+     * @throws std::system_error If the file does not exist or cannot be read.
+     */
+    SourceBuffer SourceBuffer::FromFile(const std::string& filePath) {
+        VIREO_PERF_PHASE(LOAD);
+        SourceBuffer buffer;
+
+#if VIREO_HAS_MMAP
+        const FileDescriptor file(open(filePath.c_str(), O_RDONLY | O_CLOEXEC));
+        if (file.fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "Could not open source file '" + filePath + "'");
+        }
+
+        struct stat info{};
+        if (fstat(file.fd, &info) != 0) {
+            throw std::system_error(errno, std::generic_category(), "Could not stat source file '" + filePath + "'");
+        }
+
+        // Only regular files with a known size can be mapped. Everything else (pipes, /proc entries, empty files) is read.
+        if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+            buffer.owned = ReadAll(file.fd, filePath);
+            return buffer;
+        }
+
+        const auto size = static_cast<std::size_t>(info.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+        if (mapping == MAP_FAILED) {
+            buffer.owned = ReadAll(file.fd, filePath);
+            return buffer;
+        }
+
+        // The lexer reads front to back exactly once, so ask for aggressive read-ahead. These are only hints.
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        madvise(mapping, size, MADV_WILLNEED);
+
+        buffer.storage = Storage::MAPPED;
+        buffer.externalData = static_cast<const char*>(mapping);
+        buffer.externalSize = size;
+#else
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory),
+                                    "Could not open source file '" + filePath + "'");
+        }
+
+        std::stringstream stream;
+        stream << file.rdbuf();
+        buffer.owned = std::move(stream).str();
+#endif
+
+        return buffer;
+    }
+
+    /**
+     * @brief Creates a buffer that reads text owned by someone else, without copying it.
+     *
+     * @param text The source code. It must outlive the buffer and any tokens lexed from it.
+     */
+    SourceBuffer SourceBuffer::View(const std::string_view text) {
+        SourceBuffer buffer;
+        buffer.storage = Storage::VIEW;
+        buffer.externalData = text.data();
+        buffer.externalSize = text.size();
+        return buffer;
+    }
+
+    /**
+     * @returns The source code held by this buffer.
+     */
+    std::string_view SourceBuffer::Text() const {
+        if (storage != Storage::OWNED) return {externalData, externalSize};
+        return owned;
+    }
+
+    /**
+     * @returns Whether the source code is read straight from a memory mapping of the file.
+     */
+    bool SourceBuffer::IsMapped() const {
+        return storage == Storage::MAPPED;
+    }
+
+    /**
+     * @brief Releases the memory mapping, if this buffer holds one, and forgets any external text.
+     */
+    void SourceBuffer::Unmap() {
+#if VIREO_HAS_MMAP
+        if (storage == Storage::MAPPED && externalData != nullptr) {
+            munmap(const_cast<char*>(externalData), externalSize);
+        }
+#endif
+        externalData = nullptr;
+        externalSize = 0;
+        storage = Storage::OWNED;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef SOURCEBUFFER_H
+#define SOURCEBUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace Lexer {
+    /**
+     * @brief Holds the bytes of a source file for the lexer to read from.
+     *
+     * Regular files are memory-mapped read-only so the lexer reads the page cache directly instead of a copy.
+     * Pipes, character devices and files that report a size of zero fall back to being read into an owned string.
+     * A buffer can also be a plain view of text owned by the caller, which then has to outlive the buffer.
+     */
+    class SourceBuffer {
+    private:
+        enum class Storage { OWNED, MAPPED, VIEW };
+
+        Storage storage = Storage::OWNED;
+        std::string owned;
+        const char* externalData = nullptr; // The mapping, or the caller's text for a view.
+        std::size_t externalSize = 0;
+
+        void Unmap();
+    public:
+        SourceBuffer() = default;
+        ~SourceBuffer();
+
+        SourceBuffer(const SourceBuffer&) = delete;
+        SourceBuffer& operator=(const SourceBuffer&) = delete;
+        SourceBuffer(SourceBuffer&& other) noexcept;
+        SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+
+        static SourceBuffer FromString(std::string text);
+        static SourceBuffer FromFile(const std::string& filePath);
+        static SourceBuffer View(std::string_view text);
+
+        std::string_view Text() const;
+        bool IsMapped() const;
+    };
+}
+
+#endif //SOURCEBUFFER_H
@@ -0,0 +1,105 @@
+#pragma once
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace Lexer {
+    /**
+     * @brief A bounded lock-free queue between exactly one producer thread and one consumer thread.
+     *
+     * The producer only ever stores head and the consumer only ever stores tail, so each side publishes with a single
+     * release store and no read-modify-write. Each side also keeps a cached copy of the other's index and only reloads
+     * it when the ring looks full (or empty), so in the steady state neither side touches the other's cache line.
+     * Blocking waits use atomic wait/notify on the index the other side moves, which is a futex rather than a lock.
+     */
+    template <typename T>
+    class SpscRing {
+    private:
+        static constexpr std::size_t cacheLine = 64;
+
+        std::unique_ptr<T[]> slots;
+        std::size_t mask;
+
+        alignas(cacheLine) std::atomic<std::size_t> head = 0; // Next slot to write. Stored by the producer.
+        std::size_t cachedTail = 0; // The producer's last view of tail.
+        alignas(cacheLine) std::atomic<std::size_t> tail = 0; // Next slot to read. Stored by the consumer.
+        std::size_t cachedHead = 0; // The consumer's last view of head.
+    public:
+        /**
+         * @param capacity How many items may be queued at once. Rounded up to a power of two.
+         */
+        explicit SpscRing(const std::size_t capacity)
+            : slots(std::make_unique<T[]>(std::bit_ceil(capacity == 0 ? 1 : capacity))),
+              mask(std::bit_ceil(capacity == 0 ? 1 : capacity) - 1) {}
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        std::size_t Capacity() const { return mask + 1; }
+
+        /**
+         * @brief Producer only. Queues an item if there is room.
+         *
+         * @param value Moved from if it was queued, untouched otherwise.
+         *
+         * @returns Whether the item was queued.
+         */
+        bool TryPush(T& value) {
+            const std::size_t position = head.load(std::memory_order_relaxed);
+            if (position - cachedTail > mask) {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if (position - cachedTail > mask) return false;
+            }
+
+            slots[position & mask] = std::move(value);
+            head.store(position + 1, std::memory_order_release);
+            head.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief Consumer only. Takes the oldest item if there is one.
+         *
+         * @param value Receives the item.
+         *
+         * @returns Whether an item was taken.
+         */
+        bool TryPop(T& value) {
+            const std::size_t position = tail.load(std::memory_order_relaxed);
+            if (position == cachedHead) {
+                cachedHead = head.load(std::memory_order_acquire);
+                if (position == cachedHead) return false;
+            }
+
+            value = std::move(slots[position & mask]);
+            tail.store(position + 1, std::memory_order_release);
+            tail.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief Producer only. Blocks until the ring has room, or the consumer has at least taken something.
+         */
+        void WaitForSpace() {
+            const std::size_t observed = tail.load(std::memory_order_acquire);
+            if (head.load(std::memory_order_relaxed) - observed <= mask) return;
+            tail.wait(observed, std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Consumer only. Blocks until the ring holds an item.
+         */
+        void WaitForItems() {
+            const std::size_t observed = head.load(std::memory_order_acquire);
+            if (observed != tail.load(std::memory_order_relaxed)) return;
+            head.wait(observed, std::memory_order_acquire);
+        }
+    };
+}
+
+#endif //SPSCRING_H
@@ -0,0 +1,172 @@
+#pragma once
+#ifndef STATICTOKENS_H
+#define STATICTOKENS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "diagnostic.h"
+#include "scanner.h"
+#include "token.h"
+#include "tokentype.h"
+
+namespace Lexer {
+    /**
+     * @brief A string literal as a template argument, so its text is available to constant evaluation.
+     */
+    template <std::size_t Size>
+    struct ScriptText {
+        char text[Size];
+
+        consteval ScriptText(const char (&source)[Size]) {
+            for (std::size_t i = 0; i < Size; ++i) text[i] = source[i];
+        }
+
+        constexpr std::string_view View() const { return {text, Size - 1}; }
+    };
+
+    /**
+     * @brief A token lexed at compile time. Its lexeme is kept as a position, since a constant cannot point into the
+     * object being built.
+     */
+    struct StaticToken {
+        TokenType type;
+        std::uint32_t offset;
+        std::uint32_t lexemeOffset; // Into the source, or into the decoded text if decoded is set.
+        std::uint32_t lexemeLength;
+        bool decoded;
+        std::uint64_t payload;
+    };
+
+    /**
+     * @brief The tokens of a script, lexed at compile time into arrays sized to fit.
+     *
+     * Indexing gives ordinary Tokens whose lexemes view the script text or the decoded string literals stored here, so
+     * a constexpr StaticTokens is usable for the life of the program. Identifiers have no symbol (their payload is
+     * zero), since the interner only exists at run time.
+     */
+    template <std::size_t TokenCount, std::size_t DecodedSize>
+    struct StaticTokens {
+        std::string_view source;
+        std::array<StaticToken, TokenCount> tokens;
+        std::array<char, DecodedSize == 0 ? 1 : DecodedSize> decoded; // Never empty, so its data() is always valid.
+
+        static constexpr std::size_t Size() { return TokenCount; }
+
+        constexpr Token operator[](const std::size_t index) const {
+            const StaticToken& token = tokens[index];
+            const std::string_view text = token.decoded ? std::string_view(decoded.data(), DecodedSize) : source;
+            return {token.type, text.substr(token.lexemeOffset, token.lexemeLength), token.offset, token.payload};
+        }
+    };
+
+    namespace StaticTokenizer {
+        // Deliberately not constexpr: reaching it during constant evaluation stops compilation, naming the problem.
+        inline void ScriptHasLexicalError(const DiagnosticKind) {}
+
+        /**
+         * @brief The Scanner's callbacks for constant evaluation. Tokens and decoded literals go into transient
+         * containers, and any diagnostic is a compile error, since an embedded script is fixed when it is built.
+         */
+        class ConstantScanner : public Scanner<ConstantScanner> {
+        private:
+            friend class Scanner<ConstantScanner>;
+
+            std::size_t pendingDecoded = 0; // Where DecodeBuffer put the literal Emit is about to receive.
+            bool decodedPending = false;
+
+            constexpr void Emit(const TokenType type, const std::string_view lexeme, const std::uint64_t payload) {
+                StaticToken token{type, static_cast<std::uint32_t>(start), 0, static_cast<std::uint32_t>(lexeme.size()),
+                                  decodedPending, payload};
+                if (decodedPending) {
+                    token.lexemeOffset = static_cast<std::uint32_t>(pendingDecoded);
+                    decoded.resize(pendingDecoded + lexeme.size());
+                    decodedPending = false;
+                } else {
+                    token.lexemeOffset = static_cast<std::uint32_t>(lexeme.data() - sourceCode.data());
+                }
+                tokens.push_back(token);
+            }
+
+            constexpr void Report(const Diagnostic& diagnostic) {
+                if (std::is_constant_evaluated()) ScriptHasLexicalError(diagnostic.kind);
+            }
+
+            constexpr char* DecodeBuffer(const std::size_t size) {
+                pendingDecoded = decoded.size();
+                decodedPending = true;
+                decoded.resize(pendingDecoded + size);
+                return decoded.data() + pendingDecoded;
+            }
+
+            static constexpr std::uint64_t Intern(std::string_view) { return 0; }
+        public:
+            std::vector<StaticToken> tokens;
+            std::string decoded;
+
+            constexpr explicit ConstantScanner(const std::string_view source, const bool keepComments) : Scanner(source) {
+                this->keepComments = keepComments;
+            }
+
+            /**
+             * @brief Scans the whole source, the same way Lexer::NextToken does, and ends with END_OF_FILE.
+             */
+            constexpr void Run() {
+                while (!IsAtEnd()) {
+                    start = current;
+                    ScanToken();
+                }
+                start = current;
+                tokens.push_back({TokenType::END_OF_FILE, static_cast<std::uint32_t>(current),
+                                  static_cast<std::uint32_t>(current), 0, false, 0});
+            }
+        };
+
+        struct Sizes {
+            std::size_t tokens;
+            std::size_t decoded;
+        };
+
+        template <ScriptText Source, bool KeepComments>
+        consteval Sizes Measure() {
+            ConstantScanner scanner(Source.View(), KeepComments);
+            scanner.Run();
+            return {scanner.tokens.size(), scanner.decoded.size()};
+        }
+    }
+
+    /**
+     * @brief Lexes a script at compile time, through the same Scanner as Lexer::Tokenize.
+     *
+     * Meant for scripts embedded in the binary, such as a prelude, so they cost nothing to lex at startup:
+     *
+     *     static constexpr auto prelude = Lexer::TokenizeConstant<"function id(x: int) -> int { return x; }">();
+     *
+     * A script with a lexical error does not compile, and neither does a float literal that cannot be parsed exactly
+     * without std::from_chars (more than 53 bits of digits or more than 22 after the point).
+     *
+     * @tparam Source The script.
+     * @tparam KeepComments Whether comments are kept as COMMENT tokens, as with Lexer::KeepComments.
+     *
+     * @returns The tokens, ending with END_OF_FILE, in arrays sized to fit.
+     */
+    template <ScriptText Source, bool KeepComments = false>
+    consteval auto TokenizeConstant() {
+        constexpr StaticTokenizer::Sizes sizes = StaticTokenizer::Measure<Source, KeepComments>();
+
+        StaticTokenizer::ConstantScanner scanner(Source.View(), KeepComments);
+        scanner.Run();
+
+        StaticTokens<sizes.tokens, sizes.decoded> result{Source.View(), {}, {}};
+        for (std::size_t i = 0; i < sizes.tokens; ++i) result.tokens[i] = scanner.tokens[i];
+        for (std::size_t i = 0; i < sizes.decoded; ++i) result.decoded[i] = scanner.decoded[i];
+        return result;
+    }
+}
+
+#endif //STATICTOKENS_H
@@ -0,0 +1,128 @@
+#include "streamlexer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <system_error>
+
+#include "sourcebuffer.h"
+#include "tokenspec.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+namespace Lexer {
+    namespace {
+        /**
+         * @brief Reads whatever is available, up to size bytes, retrying if interrupted.
+         *
+         * @returns How many bytes were read; zero at the end of the input.
+         *
+         * @throws std::system_error If the read fails.
+         */
+        std::size_t ReadSome(const int fd, char* destination, const std::size_t size) {
+            while (true) {
+#if defined(_WIN32)
+                const int count = _read(fd, destination, static_cast<unsigned>(size));
+#else
+                const ssize_t count = read(fd, destination, size);
+#endif
+                if (count >= 0) return static_cast<std::size_t>(count);
+                if (errno != EINTR) throw std::system_error(errno, std::generic_category(), "Could not read source stream");
+            }
+        }
+    }
+
+    /**
+     * @brief Creates a lexer over a file descriptor. Nothing is read until the first token is asked for.
+     *
+     * @param fd The descriptor to read, such as 0 for standard input. The caller keeps ownership of it.
+     * @param blockSize How much to read at a time. The window starts at twice this.
+     */
+    StreamLexer::StreamLexer(const int fd, const std::size_t blockSize)
+        : fd(fd), blockSize(blockSize == 0 ? 1 : blockSize), window(2 * this->blockSize),
+          lexer(SourceBuffer::View({})) {}
+
+    /**
+     * @brief Lexes the next token, reading more input whenever the token might continue past what has been read.
+     *
+     * @returns The next token, with its offset from the start of the stream. Once the input is exhausted, or once a
+     * token would end past the 4 GiB that 32-bit offsets can address, every call returns END_OF_FILE.
+     *
+     * @throws std::system_error If reading the descriptor fails.
+     */
+    Token StreamLexer::NextToken() {
+        if (stopped) return {TokenType::END_OF_FILE, "", stopOffset};
+
+        while (true) {
+            // Whitespace and skipped comments before the token are rescanned with it, so a comment that runs past
+            // the window is never cut in half by a refill.
+            const std::size_t scanStart = lexer.Position();
+            Token token = lexer.NextToken();
+
+            // Unless the input has ended, a token is only final once the scanner stopped further from the end of
+            // the window than it could have looked ahead. Anything else, END_OF_FILE included, is scanned again.
+            if (endOfInput || lexer.Position() + maxLookahead < filled) {
+                if (base + lexer.Position() > std::numeric_limits<std::uint32_t>::max()) {
+                    stopped = true;
+                    stopOffset = static_cast<std::uint32_t>(base + scanStart);
+                    diagnostics.push_back({DiagnosticKind::SOURCE_TOO_LARGE, stopOffset, 0, stopOffset});
+                    return {TokenType::END_OF_FILE, "", stopOffset};
+                }
+
+                const auto& found = lexer.Diagnostics();
+                for (; collected < found.size(); ++collected) {
+                    Diagnostic diagnostic = found[collected];
+                    diagnostic.offset += static_cast<std::uint32_t>(base);
+                    diagnostic.token += static_cast<std::uint32_t>(base);
+                    diagnostics.push_back(diagnostic);
+                }
+
+                token.offset += static_cast<std::uint32_t>(base);
+                return token;
+            }
+
+            Refill(scanStart);
+        }
+    }
+
+    /**
+     * @brief Drops the input before keepFrom, reads more input behind what is left, and restarts the lexer there.
+     *
+     * A short token is rescanned after a single read, so tokens come out as soon as the input behind them arrives. A
+     * long one is only rescanned once at least as much input again has been read, growing the window to fit, so a
+     * token of length N is scanned O(log N) times in all rather than once per block, however little each read returns.
+     *
+     * @param keepFrom The window position where scanning of the pending token began, trivia before it included.
+     *
+     * @throws std::system_error If reading the descriptor fails.
+     */
+    void StreamLexer::Refill(const std::size_t keepFrom) {
+        std::memmove(window.data(), window.data() + keepFrom, filled - keepFrom);
+        filled -= keepFrom;
+        base += keepFrom;
+        refills++;
+
+        // The window grows geometrically, and only when the pending token leaves less than a block (or less than its
+        // own length) free.
+        const std::size_t pending = filled;
+        while (window.size() - filled < std::max(blockSize, pending)) {
+            window.resize(2 * window.size());
+        }
+
+        std::size_t count = 0;
+        do {
+            count = ReadSome(fd, window.data() + filled, window.size() - filled);
+            filled += count;
+        } while (count != 0 && filled < 2 * pending);
+        endOfInput = count == 0;
+
+        // The rescanned token's diagnostics, if it had any, are dropped by the reset and found again.
+        lexer.Reset(std::string_view(window.data(), filled));
+        collected = 0;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef STREAMLEXER_H
+#define STREAMLEXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "diagnostic.h"
+#include "lexer.h"
+#include "token.h"
+
+namespace Lexer {
+    /**
+     * @brief Lexes input read from a file descriptor, such as a pipe, without holding all of it.
+     *
+     * Input is read in blocks into a bounded window. When a token reaches the end of what has been read, it might
+     * continue in the next block, so the unconsumed tail is moved to the front of the window, more input is read
+     * behind it, and the token is scanned again. A long token is only rescanned once its length has at least doubled,
+     * so it costs O(log N) scans rather than one per block. The window only grows when a single token needs it, so
+     * memory stays bounded by the block size and a small multiple of the longest token, whatever the size of the input.
+     *
+     * Offsets count from the start of the stream. They are 32 bits like every other token offset, so a stream is lexed
+     * up to its first 4 GiB: a token that would end past that is not produced, a SOURCE_TOO_LARGE diagnostic is
+     * reported, and the stream ends there. A token's lexeme lives in the window, so it is only valid until the next
+     * call to NextToken.
+     */
+    class StreamLexer {
+    private:
+        int fd;
+        std::size_t blockSize;
+        std::vector<char> window;
+        std::size_t filled = 0; // How many bytes of the window hold input.
+        std::uint64_t base = 0; // The stream offset of the window's first byte.
+        bool endOfInput = false;
+        bool stopped = false; // Set once the stream outgrew 32-bit offsets.
+        std::uint32_t stopOffset = 0;
+        Lexer lexer; // Over the filled part of the window.
+        std::size_t collected = 0; // How many of lexer's diagnostics have been moved to diagnostics.
+        std::size_t refills = 0;
+        std::vector<Diagnostic> diagnostics;
+
+        void Refill(std::size_t keepFrom);
+    public:
+        static constexpr std::size_t defaultBlockSize = 64 * 1024;
+
+        explicit StreamLexer(int fd, std::size_t blockSize = defaultBlockSize);
+
+        StreamLexer(const StreamLexer&) = delete;
+        StreamLexer& operator=(const StreamLexer&) = delete;
+
+        Token NextToken();
+        const std::vector<Diagnostic>& Diagnostics() const { return diagnostics; }
+        void KeepComments(bool keep) { lexer.KeepComments(keep); }
+        std::size_t WindowSize() const { return window.size(); }
+        std::size_t Refills() const { return refills; }
+    };
+}
+
+#endif //STREAMLEXER_H
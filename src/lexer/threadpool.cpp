@@ -0,0 +1,129 @@
+#include "threadpool.h"
+#include <utility>
+
+namespace Lexer {
+    namespace {
+        // The pool and queue of the worker running on this thread, so nested submissions stay local.
+        thread_local const ThreadPool* currentPool = nullptr;
+        thread_local std::size_t currentQueue = 0;
+    }
+
+    /**
+     * @brief Starts the worker threads.
+     *
+     * @param threadCount How many workers to start. Zero (what hardware_concurrency returns when it cannot tell) means one.
+     */
+    ThreadPool::ThreadPool(const std::size_t threadCount) {
+        const std::size_t count = threadCount == 0 ? 1 : threadCount;
+        queues.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+
+        workers.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            workers.emplace_back([this, i] { WorkerLoop(i); });
+        }
+    }
+
+    /**
+     * @brief Finishes every queued task, then stops and joins the workers.
+     */
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * @returns The number of worker threads.
+     */
+    std::size_t ThreadPool::Size() const {
+        return workers.size();
+    }
+
+    /**
+     * @brief Runs one queued task on the calling thread, if there is one.
+     *
+     * @returns Whether a task was run.
+     */
+    bool ThreadPool::RunPendingTask() {
+        std::function<void()> task;
+        if (!TakeTask(currentPool == this ? currentQueue : nextQueue.load() % queues.size(), task)) return false;
+
+        task();
+        return true;
+    }
+
+    /**
+     * @brief Adds a task to a queue and wakes a worker for it.
+     */
+    void ThreadPool::Enqueue(std::function<void()> task) {
+        // Count the task before it can be taken, so pending never drops below the number of tasks in the queues.
+        {
+            std::lock_guard lock(sleepMutex);
+            pending.fetch_add(1);
+        }
+
+        if (currentPool == this) {
+            Queue& queue = *queues[currentQueue];
+            std::lock_guard lock(queue.mutex);
+            queue.tasks.push_front(std::move(task));
+        } else {
+            Queue& queue = *queues[nextQueue.fetch_add(1) % queues.size()];
+            std::lock_guard lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    /**
+     * @brief Takes the next task from a queue, or steals one from another queue if that one is empty.
+     *
+     * @param home The queue to look in first.
+     * @param task Receives the task.
+     *
+     * @returns Whether a task was found.
+     */
+    bool ThreadPool::TakeTask(const std::size_t home, std::function<void()>& task) {
+        for (std::size_t i = 0; i < queues.size(); i++) {
+            Queue& queue = *queues[(home + i) % queues.size()];
+            std::lock_guard lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            pending.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Runs tasks until the pool is stopping and every queue is empty.
+     *
+     * @param index The worker's own queue.
+     */
+    void ThreadPool::WorkerLoop(const std::size_t index) {
+        currentPool = this;
+        currentQueue = index;
+
+        while (true) {
+            std::function<void()> task;
+            if (TakeTask(index, task)) {
+                task();
+                continue;
+            }
+
+            std::unique_lock lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || pending.load() > 0; });
+            if (stopping && pending.load() == 0) return;
+        }
+    }
+}
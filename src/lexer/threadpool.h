@@ -0,0 +1,111 @@
+#pragma once
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Lexer {
+    /**
+     * @brief A fixed set of worker threads that share out submitted tasks by work stealing.
+     *
+     * Each worker has a queue of its own. Tasks submitted from outside the pool are dealt to the queues round-robin and
+     * each queue runs them in order. A task submitted by a worker goes to the front of that worker's queue, so nested
+     * work runs before the backlog. A worker whose queue is empty steals from the front of the others.
+     */
+    class ThreadPool {
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<Queue>> queues; // One per worker.
+        std::atomic<std::size_t> nextQueue = 0; // Where the next task from outside the pool goes.
+        std::atomic<std::size_t> pending = 0; // Tasks queued but not yet taken. Only raised while holding sleepMutex.
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+
+        void Enqueue(std::function<void()> task);
+        bool TakeTask(std::size_t home, std::function<void()>& task);
+        void WorkerLoop(std::size_t index);
+    public:
+        explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        std::size_t Size() const;
+        bool RunPendingTask();
+
+        /**
+         * @brief Queues a task to run on one of the workers.
+         *
+         * @returns A future for the task's result. Exceptions thrown by the task are rethrown from the future.
+         */
+        template <typename Function>
+        std::future<std::invoke_result_t<Function>> Submit(Function&& function) {
+            using Result = std::invoke_result_t<Function>;
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+            std::future<Result> result = task->get_future();
+            Enqueue([task] { (*task)(); });
+            return result;
+        }
+
+        /**
+         * @brief Waits for a task's result, running other queued tasks in the meantime.
+         *
+         * Safe to call from a worker: a task that submits work and waits for it helps run it instead of blocking a thread.
+         * Once every queue is empty, the task is already running elsewhere, so the caller sleeps until it finishes
+         * rather than spinning next to the workers.
+         *
+         * @returns The task's result. Exceptions thrown by the task are rethrown.
+         */
+        template <typename Result>
+        Result Wait(std::future<Result>& future) {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                if (!RunPendingTask()) {
+                    future.wait();
+                    break;
+                }
+            }
+            return future.get();
+        }
+
+        /**
+         * @brief Waits for every task in a batch, even after one of them fails.
+         *
+         * Tasks in a batch usually write into storage owned by the caller, so the caller must not unwind while any of
+         * them is still queued or running.
+         *
+         * @throws The first exception thrown by one of the tasks, once all of them have finished.
+         */
+        void WaitAll(std::vector<std::future<void>>& futures) {
+            std::exception_ptr failure;
+            for (std::future<void>& future : futures) {
+                try {
+                    Wait(future);
+                } catch (...) {
+                    if (!failure) failure = std::current_exception();
+                }
+            }
+            if (failure) std::rethrow_exception(failure);
+        }
+    };
+}
+
+#endif //THREADPOOL_H
@@ -0,0 +1,124 @@
+#include "timetrace.h"
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+
+namespace Lexer {
+    namespace {
+        std::atomic<std::uint32_t> nextThread{1};
+
+        // A small number per thread, since trace viewers give each thread id its own row.
+        thread_local std::uint32_t currentThread = 0;
+
+        std::uint32_t ThreadNumber() {
+            if (currentThread == 0) currentThread = nextThread.fetch_add(1, std::memory_order_relaxed);
+            return currentThread;
+        }
+
+        /**
+         * @brief Writes text as a JSON string literal, quotes included.
+         */
+        void WriteJsonString(std::ostream& out, const std::string_view text) {
+            out << '"';
+            for (const char c : text) {
+                switch (c) {
+                    case '"': out << "\\\""; break;
+                    case '\\': out << "\\\\"; break;
+                    case '\n': out << "\\n"; break;
+                    case '\t': out << "\\t"; break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            char escaped[8];
+                            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                            out << escaped;
+                        } else {
+                            out << c;
+                        }
+                }
+            }
+            out << '"';
+        }
+    }
+
+    /**
+     * @brief Starts a trace and makes it the active one. Its timestamps count from now.
+     */
+    TimeTrace::TimeTrace() : origin(Clock::now()) {
+        active.store(this, std::memory_order_release);
+    }
+
+    TimeTrace::~TimeTrace() {
+        TimeTrace* self = this;
+        active.compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+    }
+
+    /**
+     * @brief Records a finished span on the calling thread.
+     *
+     * @param name What the span is.
+     * @param detail What it is about, or empty.
+     * @param start When it began.
+     * @param end When it ended.
+     */
+    void TimeTrace::Add(const std::string_view name, const std::string_view detail, const Clock::time_point start,
+                        const Clock::time_point end) {
+        const auto microseconds = [](const Clock::duration duration) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        };
+        Event event{std::string(name), std::string(detail), microseconds(start - origin), microseconds(end - start),
+                    ThreadNumber()};
+
+        const std::lock_guard lock(mutex);
+        events.push_back(std::move(event));
+    }
+
+    /**
+     * @returns How many spans have been recorded.
+     */
+    std::size_t TimeTrace::Size() const {
+        const std::lock_guard lock(mutex);
+        return events.size();
+    }
+
+    /**
+     * @brief Writes every span recorded so far as complete ("X") trace events.
+     *
+     * @param out Where to write the JSON.
+     */
+    void TimeTrace::Write(std::ostream& out) const {
+        const std::lock_guard lock(mutex);
+
+        out << "{\"traceEvents\":[";
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            const Event& event = events[i];
+            out << (i == 0 ? "\n" : ",\n") << "{\"name\":";
+            WriteJsonString(out, event.name);
+            out << ",\"cat\":\"vireo\",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration
+                << ",\"pid\":1,\"tid\":" << event.thread;
+            if (!event.detail.empty()) {
+                out << ",\"args\":{\"detail\":";
+                WriteJsonString(out, event.detail);
+                out << '}';
+            }
+            out << '}';
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    /**
+     * @brief Writes the trace to a file, replacing it if it exists.
+     *
+     * @param path Where to write the JSON.
+     *
+     * @throws std::system_error If the file cannot be written.
+     */
+    void TimeTrace::WriteFile(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (file) Write(file);
+        if (file) file.flush();
+        if (!file) {
+            throw std::system_error(errno ? errno : EIO, std::generic_category(), "Could not write time trace '" + path + "'");
+        }
+    }
+}
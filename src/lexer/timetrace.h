@@ -0,0 +1,84 @@
+#pragma once
+#ifndef TIMETRACE_H
+#define TIMETRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Lexer {
+    /**
+     * @brief Records timed spans from any thread and writes them as Chrome trace-event JSON.
+     *
+     * The output opens in Perfetto or chrome://tracing, with one row per thread. Construction makes this the
+     * process's active trace, which TraceScope records into. With no active trace a scope costs one atomic load, so
+     * phases can be instrumented unconditionally.
+     */
+    class TimeTrace {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Event {
+            std::string name;
+            std::string detail; // Shown as the span's argument, such as the file it is about. May be empty.
+            std::int64_t start; // Microseconds since the trace began.
+            std::int64_t duration;
+            std::uint32_t thread;
+        };
+
+        static inline std::atomic<TimeTrace*> active = nullptr;
+
+        Clock::time_point origin;
+        mutable std::mutex mutex;
+        std::vector<Event> events;
+    public:
+        TimeTrace();
+        ~TimeTrace();
+
+        TimeTrace(const TimeTrace&) = delete;
+        TimeTrace& operator=(const TimeTrace&) = delete;
+
+        static TimeTrace* Active() { return active.load(std::memory_order_acquire); }
+
+        void Add(std::string_view name, std::string_view detail, Clock::time_point start, Clock::time_point end);
+        std::size_t Size() const;
+        void Write(std::ostream& out) const;
+        void WriteFile(const std::string& path) const;
+    };
+
+    /**
+     * @brief Records its own lifetime as a span of the active trace, if there is one.
+     */
+    class TraceScope {
+    private:
+        TimeTrace* trace;
+        std::string_view name;
+        std::string detail;
+        std::chrono::steady_clock::time_point start;
+    public:
+        /**
+         * @param name What the span is, such as "Lex". Must outlive the scope; normally a literal.
+         * @param detail What it is about, such as a file name.
+         */
+        explicit TraceScope(const std::string_view name, const std::string_view detail = {})
+            : trace(TimeTrace::Active()), name(name) {
+            if (!trace) return;
+            this->detail = detail;
+            start = std::chrono::steady_clock::now();
+        }
+
+        ~TraceScope() {
+            if (trace) trace->Add(name, detail, start, std::chrono::steady_clock::now());
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+    };
+}
+
+#endif //TIMETRACE_H
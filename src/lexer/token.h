@@ -2,18 +2,41 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#include <string>
-#include <utility>
+#include <bit>
+#include <cstdint>
+#include <string_view>
 
+#include "interner.h"
 #include "tokentype.h"
 
 namespace Lexer {
+    /**
+     * @brief A single token produced by the lexer.
+     *
+     * The lexeme is a view into storage owned by the Lexer that produced the token: usually the source buffer
+     * itself, or the lexer's owned lexeme storage for tokens whose text had to be rewritten. Tokens are therefore
+     * only valid for as long as that Lexer is alive.
+     *
+     * Only the byte offset of the token is recorded; the line and column are resolved on demand through a LineIndex.
+     *
+     * Tokens also carry an 8-byte payload decoded during lexing, so later stages never re-parse the lexeme:
+     * the interned SymbolId of an IDENTIFIER, the value of an INT_LITERAL or FLOAT_LITERAL, or the value of a
+     * BOOL_LITERAL. Read it through the accessor that matches the token's type.
+     */
     struct Token {
         TokenType type;
-        std::string lexeme;
-        int line;
+        std::uint32_t offset; // Byte offset of the token's first character in the source.
+        std::string_view lexeme;
+        std::uint64_t payload; // Zero for token types without a value.
 
-        Token(const TokenType type, std::string  lexeme, const int line) : type(type), lexeme(std::move(lexeme)), line(line) {}
+        constexpr Token(const TokenType type, const std::string_view lexeme, const std::uint32_t offset,
+                        const std::uint64_t payload = 0)
+            : type(type), offset(offset), lexeme(lexeme), payload(payload) {}
+
+        constexpr SymbolId Symbol() const { return static_cast<SymbolId>(payload); }
+        constexpr std::int64_t IntValue() const { return static_cast<std::int64_t>(payload); }
+        constexpr double FloatValue() const { return std::bit_cast<double>(payload); }
+        constexpr bool BoolValue() const { return payload != 0; }
     };
 }
 
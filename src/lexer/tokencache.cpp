@@ -0,0 +1,327 @@
+#include "tokencache.h"
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include "interner.h"
+#include "sourcebuffer.h"
+#include "tokenspec.h"
+
+namespace Lexer {
+    namespace {
+        constexpr std::array<char, 4> entryMagic = {'V', 'T', 'C', '1'};
+
+        // Fixed-size header at the start of every entry. The body follows, and is bodySize bytes long.
+        struct EntryHeader {
+            std::array<char, 4> magic;
+            std::uint32_t version;
+            std::uint32_t options;
+            std::uint32_t tokenCount;
+            std::uint64_t sourceHash;
+            std::uint64_t sourceSize;
+            std::uint32_t symbolCount;
+            std::uint32_t detachedCount;
+            std::uint32_t diagnosticCount;
+            std::uint32_t reserved;
+            std::uint64_t bodySize;
+            std::uint64_t checksum; // Hash of the body.
+        };
+
+        struct DetachedEntry {
+            std::uint32_t index;
+            std::uint32_t length;
+        };
+
+        struct DiagnosticEntry {
+            std::uint32_t kind;
+            std::uint32_t offset;
+            std::uint32_t length;
+            std::uint32_t token;
+        };
+
+        // Appends an array to the body, padded to eight bytes so the next one starts aligned.
+        template <typename T>
+        void Write(std::string& body, const T* data, const std::size_t count) {
+            body.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+            body.resize((body.size() + 7) & ~std::size_t{7});
+        }
+
+        // Views an array written by Write in place, failing if the body is too short for it. The body must start
+        // eight-byte aligned, which Write keeps it.
+        template <typename T>
+        bool Read(std::string_view& body, std::span<const T>& items, const std::size_t count) {
+            const std::size_t size = count * sizeof(T);
+            const std::size_t padded = (size + 7) & ~std::size_t{7};
+            if (padded > body.size()) return false;
+
+            items = {reinterpret_cast<const T*>(body.data()), count};
+            body.remove_prefix(padded);
+            return true;
+        }
+
+        std::uint64_t Load64(const char* bytes) {
+            std::uint64_t value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+
+        std::uint64_t Round(const std::uint64_t lane, const std::uint64_t input) {
+            constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87, prime2 = 0xC2B2AE3D27D4EB4F;
+            return std::rotl(lane + input * prime2, 31) * prime1;
+        }
+    }
+
+    /**
+     * @brief Opens a cache in a directory, creating the directory if needed.
+     *
+     * A directory that cannot be created is not an error: every lookup then misses and every store fails quietly.
+     *
+     * @param directory Where the entries live. Several processes may share it.
+     * @param verify Whether a lookup also checks the entry's checksum and every token in it, to catch entries damaged
+     * on disk. Entries are only ever published whole (see Store), so this is off by default.
+     */
+    TokenCache::TokenCache(std::filesystem::path directory, const bool verify) : directory(std::move(directory)), verify(verify) {
+        std::error_code error;
+        std::filesystem::create_directories(this->directory, error);
+    }
+
+    /**
+     * @brief Hashes bytes for use as a cache key, four 64-bit lanes at a time.
+     *
+     * @param bytes The bytes to hash.
+     * @param seed Mixed into the result, to derive independent hashes of the same bytes.
+     *
+     * @returns A 64-bit hash.
+     */
+    std::uint64_t TokenCache::Hash(const std::string_view bytes, const std::uint64_t seed) {
+        constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87, prime2 = 0xC2B2AE3D27D4EB4F, prime3 = 0x165667B19E3779F9;
+        const char* data = bytes.data();
+        const std::size_t size = bytes.size();
+        std::size_t i = 0;
+
+        std::uint64_t hash = seed + prime3 + size;
+        if (size >= 32) {
+            std::array<std::uint64_t, 4> lanes = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+            for (; i + 32 <= size; i += 32) {
+                for (std::size_t lane = 0; lane < lanes.size(); lane++) {
+                    lanes[lane] = Round(lanes[lane], Load64(data + i + lane * 8));
+                }
+            }
+            hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+            for (const std::uint64_t lane : lanes) {
+                hash = (hash ^ Round(0, lane)) * prime1 + prime3;
+            }
+            hash += size;
+        }
+
+        for (; i + 8 <= size; i += 8) {
+            hash = std::rotl(hash ^ Round(0, Load64(data + i)), 27) * prime1 + prime3;
+        }
+        for (; i < size; i++) {
+            hash = std::rotl(hash ^ static_cast<std::uint8_t>(data[i]) * prime3, 11) * prime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    /**
+     * @returns The file that holds the entry for a source hash and set of lexer options.
+     */
+    std::filesystem::path TokenCache::EntryPath(const std::uint64_t sourceHash, const std::uint32_t options) const {
+        std::array<char, 32> name{};
+        const int length = std::snprintf(name.data(), name.size(), "%016llx-%u.vtc",
+                                         static_cast<unsigned long long>(sourceHash), static_cast<unsigned>(options));
+        return directory / std::string(name.data(), static_cast<std::size_t>(length));
+    }
+
+    /**
+     * @brief Looks up the tokens for a source.
+     *
+     * A hit hashes the source and maps the entry. The loaded stream reads its arrays from the mapping rather than a
+     * copy, and only the distinct identifier spellings, the lexemes outside the source and the diagnostics are read
+     * out of it.
+     *
+     * @param source The source code. The loaded stream's offsets refer to it.
+     * @param options The lexer options the tokens were produced with, since they change the output.
+     * @param tokens Receives the tokens on a hit.
+     * @param diagnostics Receives the diagnostics on a hit.
+     *
+     * @returns Whether a valid entry was found. Nothing is changed on a miss.
+     */
+    bool TokenCache::Load(const std::string_view source, const std::uint32_t options, TokenStream& tokens,
+                          std::vector<Diagnostic>& diagnostics) const {
+        const std::uint64_t sourceHash = Hash(source);
+
+        auto entry = std::make_shared<SourceBuffer>();
+        try {
+            *entry = SourceBuffer::FromFile(EntryPath(sourceHash, options).string());
+        } catch (const std::system_error&) {
+            return false;
+        }
+
+        std::string_view body = entry->Text();
+        EntryHeader header{};
+        if (body.size() < sizeof(header) || reinterpret_cast<std::uintptr_t>(body.data()) % alignof(EntryHeader) != 0) {
+            return false;
+        }
+        std::memcpy(&header, body.data(), sizeof(header));
+        body.remove_prefix(sizeof(header));
+
+        if (header.magic != entryMagic || header.version != lexerVersion || header.options != options ||
+            header.sourceHash != sourceHash || header.sourceSize != source.size() || header.bodySize != body.size() ||
+            (verify && header.checksum != Hash(body, lexerVersion))) {
+            return false;
+        }
+
+        const std::size_t count = header.tokenCount;
+        std::span<const std::uint64_t> payloads;
+        std::span<const std::uint32_t> offsets, lexemeOffsets, lengths, symbolTokens;
+        std::span<const std::uint8_t> types;
+        std::span<const DetachedEntry> detached;
+        std::span<const DiagnosticEntry> problems;
+
+        if (!Read(body, payloads, count) || !Read(body, offsets, count) || !Read(body, lexemeOffsets, count) ||
+            !Read(body, lengths, count) || !Read(body, types, count) || !Read(body, symbolTokens, header.symbolCount) ||
+            !Read(body, detached, header.detachedCount) || !Read(body, problems, header.diagnosticCount)) {
+            return false;
+        }
+
+        // Symbol ids only mean something within one process, so each distinct spelling is interned again, once. The
+        // identifiers' payloads stay entry-local numbers, which the stream translates as it reads them.
+        std::vector<SymbolId> symbols(symbolTokens.size());
+        for (std::size_t i = 0; i < symbols.size(); i++) {
+            const std::uint32_t token = symbolTokens[i];
+            if (token >= count || lexemeOffsets[token] + std::uint64_t{lengths[token]} > source.size()) return false;
+            symbols[i] = Interner::Global().Intern(source.substr(lexemeOffsets[token], lengths[token]));
+        }
+        if (verify) {
+            for (std::size_t i = 0; i < count; i++) {
+                if (types[i] >= tokenTypeCount) return false;
+                if (static_cast<TokenType>(types[i]) == TokenType::IDENTIFIER && payloads[i] >= symbols.size()) return false;
+            }
+        }
+
+        TokenStream loaded(source);
+        for (const DetachedEntry& lexeme : detached) {
+            if (lexeme.index >= count || lexeme.length > body.size()) return false;
+            loaded.detachedLexemes.emplace(lexeme.index, std::string(body.substr(0, lexeme.length)));
+            body.remove_prefix(lexeme.length);
+        }
+
+        loaded.types.View(types);
+        loaded.offsets.View(offsets);
+        loaded.lexemeOffsets.View(lexemeOffsets);
+        loaded.lengths.View(lengths);
+        loaded.payloads.View(payloads);
+        loaded.symbols = std::move(symbols);
+        loaded.storage = std::move(entry);
+
+        tokens = std::move(loaded);
+        diagnostics.clear();
+        for (const DiagnosticEntry& problem : problems) {
+            diagnostics.push_back({static_cast<DiagnosticKind>(problem.kind), problem.offset, problem.length, problem.token});
+        }
+        return true;
+    }
+
+    /**
+     * @brief Writes the tokens for a source to the cache, replacing any existing entry.
+     *
+     * The entry is written to a temporary file and renamed into place, so a concurrent reader sees either the old
+     * entry, the new one or none, never a partial one.
+     *
+     * @param tokens The tokens. Their source is what the entry is keyed by.
+     * @param options The lexer options the tokens were produced with.
+     * @param diagnostics The diagnostics produced along with the tokens.
+     *
+     * @returns Whether the entry was written.
+     */
+    bool TokenCache::Store(const TokenStream& tokens, const std::uint32_t options,
+                           const std::vector<Diagnostic>& diagnostics) const {
+        const std::string_view source = tokens.Source();
+        const std::size_t count = tokens.Size();
+
+        // Identifier payloads become indices into a table of the first token with each symbol.
+        std::vector<std::uint64_t> payloads(tokens.payloads.begin(), tokens.payloads.end());
+        std::vector<std::uint32_t> symbolTokens;
+        std::unordered_map<SymbolId, std::uint32_t> symbolIndices;
+        for (std::size_t i = 0; i < count; i++) {
+            if (tokens.Type(i) != TokenType::IDENTIFIER) continue;
+
+            const auto [symbol, inserted] = symbolIndices.try_emplace(tokens.Symbol(i), static_cast<std::uint32_t>(symbolTokens.size()));
+            if (inserted) symbolTokens.push_back(static_cast<std::uint32_t>(i));
+            payloads[i] = symbol->second;
+        }
+
+        std::vector<DetachedEntry> detached;
+        std::string detachedBytes;
+        for (std::size_t i = 0; i < count; i++) {
+            const auto lexeme = tokens.detachedLexemes.find(static_cast<std::uint32_t>(i));
+            if (lexeme == tokens.detachedLexemes.end()) continue;
+
+            detached.push_back({static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(lexeme->second.size())});
+            detachedBytes += lexeme->second;
+        }
+
+        std::vector<DiagnosticEntry> problems;
+        problems.reserve(diagnostics.size());
+        for (const Diagnostic& diagnostic : diagnostics) {
+            problems.push_back({static_cast<std::uint32_t>(diagnostic.kind), diagnostic.offset, diagnostic.length, diagnostic.token});
+        }
+
+        std::string body;
+        body.reserve(count * 21 + detachedBytes.size() + problems.size() * sizeof(DiagnosticEntry) + 64);
+        Write(body, payloads.data(), count);
+        Write(body, tokens.offsets.Data(), count);
+        Write(body, tokens.lexemeOffsets.Data(), count);
+        Write(body, tokens.lengths.Data(), count);
+        Write(body, tokens.types.Data(), count);
+        Write(body, symbolTokens.data(), symbolTokens.size());
+        Write(body, detached.data(), detached.size());
+        Write(body, problems.data(), problems.size());
+        body += detachedBytes;
+
+        const std::uint64_t sourceHash = Hash(source);
+        const EntryHeader header = {
+            entryMagic, lexerVersion, options, static_cast<std::uint32_t>(count), sourceHash, source.size(),
+            static_cast<std::uint32_t>(symbolTokens.size()), static_cast<std::uint32_t>(detached.size()),
+            static_cast<std::uint32_t>(problems.size()), 0, body.size(), Hash(body, lexerVersion)
+        };
+
+        const std::filesystem::path path = EntryPath(sourceHash, options);
+        std::filesystem::path temporary = path;
+        temporary += ".tmp" + std::to_string(std::random_device()());
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(body.data(), static_cast<std::streamsize>(body.size()));
+            if (!file) {
+                file.close();
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (!error) return true;
+
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+}
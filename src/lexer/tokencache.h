@@ -0,0 +1,46 @@
+#pragma once
+#ifndef TOKENCACHE_H
+#define TOKENCACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "diagnostic.h"
+#include "tokenstream.h"
+
+namespace Lexer {
+    // Bump whenever a change to the lexer alters the tokens or diagnostics it produces for some input. Every cache
+    // entry written by an older lexer is then ignored.
+    //
+    // 2: kept comments are checked as UTF-8, and numbers are parsed by the shared constexpr scanner.
+    inline constexpr std::uint32_t lexerVersion = 2;
+
+    /**
+     * @brief An on-disk cache of lexed token streams, keyed by a hash of the source bytes and the lexer version.
+     *
+     * Each entry is one file in a compact binary format: a header, the stream's arrays as they are laid out in memory,
+     * the lexemes that are not slices of the source, and the diagnostics. A lookup hashes the source and maps the entry,
+     * and the loaded stream reads its arrays from the mapping. Identifiers are stored against a per-entry symbol table
+     * whose spellings are re-interned on load, since symbol ids are only meaningful within one process. Entries whose
+     * header or size does not match, or with verification on whose checksum does not, are treated as missing, and are
+     * replaced on the next store.
+     */
+    class TokenCache {
+    private:
+        std::filesystem::path directory;
+        bool verify;
+
+        std::filesystem::path EntryPath(std::uint64_t sourceHash, std::uint32_t options) const;
+    public:
+        explicit TokenCache(std::filesystem::path directory, bool verify = false);
+
+        bool Load(std::string_view source, std::uint32_t options, TokenStream& tokens, std::vector<Diagnostic>& diagnostics) const;
+        bool Store(const TokenStream& tokens, std::uint32_t options, const std::vector<Diagnostic>& diagnostics) const;
+
+        static std::uint64_t Hash(std::string_view bytes, std::uint64_t seed = 0);
+    };
+}
+
+#endif //TOKENCACHE_H
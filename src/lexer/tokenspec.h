@@ -0,0 +1,122 @@
+#pragma once
+#ifndef TOKENSPEC_H
+#define TOKENSPEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "tokentype.h"
+
+namespace Lexer {
+    enum class TokenKind {
+        KEYWORD, // A reserved word that would otherwise lex as an identifier.
+        PUNCTUATOR, // An operator or punctuation mark with a fixed spelling.
+        LITERAL, // Scanned by dedicated code: identifiers, numbers and strings.
+        TRIVIA, // Source text the parser does not see, such as comments. Only produced when asked for.
+        META // Produced by the lexer itself rather than read from the source.
+    };
+
+    struct TokenSpec {
+        TokenType type;
+        TokenKind kind;
+        std::string_view spelling; // Empty unless the kind is KEYWORD or PUNCTUATOR.
+    };
+
+    // The single description of Vireo's token set, in TokenType order. The keyword hash and the scanner's
+    // transition tables are both generated from this at compile time, so a new keyword or operator only needs an
+    // entry here (and in TokenType).
+    inline constexpr TokenSpec tokenSpecs[] = {
+        // Keywords
+        {TokenType::FUNCTION, TokenKind::KEYWORD, "function"},
+        {TokenType::IF,       TokenKind::KEYWORD, "if"},
+        {TokenType::ELSE,     TokenKind::KEYWORD, "else"},
+        {TokenType::ELSE_IF,  TokenKind::KEYWORD, "else_if"},
+        {TokenType::WHILE,    TokenKind::KEYWORD, "while"},
+        {TokenType::FOR,      TokenKind::KEYWORD, "for"},
+        {TokenType::RETURN,   TokenKind::KEYWORD, "return"},
+        {TokenType::VAR,      TokenKind::KEYWORD, "var"},
+
+        // Types
+        {TokenType::TYPE_INT,    TokenKind::KEYWORD, "int"},
+        {TokenType::TYPE_FLOAT,  TokenKind::KEYWORD, "float"},
+        {TokenType::TYPE_STRING, TokenKind::KEYWORD, "string"},
+        {TokenType::TYPE_BOOL,   TokenKind::KEYWORD, "bool"},
+
+        // Literals and Identifiers
+        {TokenType::IDENTIFIER,     TokenKind::LITERAL, ""},
+        {TokenType::INT_LITERAL,    TokenKind::LITERAL, ""},
+        {TokenType::FLOAT_LITERAL,  TokenKind::LITERAL, ""},
+        {TokenType::STRING_LITERAL, TokenKind::LITERAL, ""},
+        {TokenType::BOOL_LITERAL,   TokenKind::KEYWORD, "true"},
+        {TokenType::BOOL_LITERAL,   TokenKind::KEYWORD, "false"},
+
+        // Operators
+        {TokenType::PLUS,     TokenKind::PUNCTUATOR, "+"},
+        {TokenType::MINUS,    TokenKind::PUNCTUATOR, "-"},
+        {TokenType::MUL,      TokenKind::PUNCTUATOR, "*"},
+        {TokenType::DIV,      TokenKind::PUNCTUATOR, "/"},
+        {TokenType::EQUAL_TO, TokenKind::PUNCTUATOR, "=="},
+        {TokenType::LESS,     TokenKind::PUNCTUATOR, "<"},
+        {TokenType::GREATER,  TokenKind::PUNCTUATOR, ">"},
+        {TokenType::AND,      TokenKind::PUNCTUATOR, "&&"},
+        {TokenType::OR,       TokenKind::PUNCTUATOR, "||"},
+        {TokenType::ASSIGN,   TokenKind::PUNCTUATOR, "="},
+
+        // Punctuation
+        {TokenType::LEFT_PAREN,  TokenKind::PUNCTUATOR, "("},
+        {TokenType::RIGHT_PAREN, TokenKind::PUNCTUATOR, ")"},
+        {TokenType::LEFT_BRACE,  TokenKind::PUNCTUATOR, "{"},
+        {TokenType::RIGHT_BRACE, TokenKind::PUNCTUATOR, "}"},
+        {TokenType::COMMA,       TokenKind::PUNCTUATOR, ","},
+        {TokenType::COLON,       TokenKind::PUNCTUATOR, ":"},
+        {TokenType::SEMICOLON,   TokenKind::PUNCTUATOR, ";"},
+        {TokenType::ARROW,       TokenKind::PUNCTUATOR, "->"},
+
+        // Trivia
+        {TokenType::COMMENT,     TokenKind::TRIVIA, ""},
+
+        // Meta
+        {TokenType::END_OF_FILE, TokenKind::META, ""},
+        {TokenType::UNKNOWN,     TokenKind::META, ""},
+    };
+
+    inline constexpr std::size_t tokenTypeCount = static_cast<std::size_t>(TokenType::UNKNOWN) + 1;
+
+    /**
+     * @returns How many entries of tokenSpecs have the given kind.
+     */
+    constexpr std::size_t CountTokenSpecs(const TokenKind kind) {
+        std::size_t count = 0;
+        for (const TokenSpec& spec : tokenSpecs) count += spec.kind == kind;
+        return count;
+    }
+
+    /**
+     * @returns Whether every TokenType has an entry, with entries listed in TokenType order.
+     */
+    constexpr bool TokenSpecsMirrorTokenType() {
+        std::size_t expected = 0;
+        for (const TokenSpec& spec : tokenSpecs) {
+            const auto type = static_cast<std::size_t>(spec.type);
+            if (type == expected) expected++;
+            else if (type + 1 != expected) return false; // Only repeats of the previous type (extra spellings) may follow.
+        }
+        return expected == tokenTypeCount;
+    }
+
+    static_assert(TokenSpecsMirrorTokenType(), "tokenSpecs must list every TokenType, in order.");
+
+    // How far past the end of a token the scanner may read before deciding where the token ends: a number peeks at
+    // the '.' and the digit after it, an identifier decodes the code point after it (up to four bytes), and the
+    // punctuator DFA may read a partial longer spelling. Code that lexes part of a text stays this far from its edge.
+    inline constexpr std::uint32_t maxLookahead = [] {
+        std::size_t lookahead = 4;
+        for (const TokenSpec& spec : tokenSpecs) {
+            if (spec.kind == TokenKind::PUNCTUATOR && spec.spelling.size() > lookahead) lookahead = spec.spelling.size();
+        }
+        return static_cast<std::uint32_t>(lookahead);
+    }();
+}
+
+#endif //TOKENSPEC_H
@@ -0,0 +1,257 @@
+#include "tokenstream.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include <utility>
+
+namespace Lexer {
+    /**
+     * @brief Creates an empty stream for tokens lexed from source.
+     *
+     * @param source The text the tokens' offsets refer to. It must outlive the stream.
+     */
+    TokenStream::TokenStream(const std::string_view source) : source(source) {}
+
+    /**
+     * @brief Appends a token, storing its lexeme as an offset into the source when it is a slice of it.
+     *
+     * @param token The token to append.
+     */
+    void TokenStream::Append(const Token& token) {
+        const std::uint32_t index = static_cast<std::uint32_t>(Size());
+        const auto length = static_cast<std::uint32_t>(token.lexeme.size());
+
+        if (const char* data = token.lexeme.data();
+            std::greater_equal<const char*>()(data, source.data()) &&
+            std::less_equal<const char*>()(data + length, source.data() + source.size())) {
+            Append(token.type, token.offset, static_cast<std::uint32_t>(data - source.data()), length, token.payload);
+            return;
+        }
+
+        Append(token.type, token.offset, token.offset, length, token.payload);
+        if (length > 0) {
+            detachedLexemes.emplace(index, std::string(token.lexeme));
+        }
+    }
+
+    /**
+     * @brief Appends a token given as a slice of the source.
+     *
+     * @param type The type of the token.
+     * @param offset Where the token starts in the source.
+     * @param lexemeOffset Where the lexeme starts in the source.
+     * @param length The length of the lexeme.
+     * @param payload The token's decoded value, if its type has one.
+     */
+    void TokenStream::Append(const TokenType type, const std::uint32_t offset, const std::uint32_t lexemeOffset,
+                             const std::uint32_t length, const std::uint64_t payload) {
+        if (storage) Resolve();
+        types.Push(static_cast<std::uint8_t>(type));
+        offsets.Push(offset);
+        lexemeOffsets.Push(lexemeOffset);
+        lengths.Push(length);
+        payloads.Push(payload);
+    }
+
+    /**
+     * @brief Makes room for count tokens in every array at once.
+     */
+    void TokenStream::Reserve(const std::size_t count) {
+        if (storage) Resolve();
+        types.Reserve(count);
+        offsets.Reserve(count);
+        lexemeOffsets.Reserve(count);
+        lengths.Reserve(count);
+        payloads.Reserve(count);
+    }
+
+    /**
+     * @brief Removes every token but keeps the arrays' capacity.
+     */
+    void TokenStream::Clear() {
+        types.Clear();
+        offsets.Clear();
+        lexemeOffsets.Clear();
+        lengths.Clear();
+        payloads.Clear();
+        detachedLexemes.clear();
+        storage.reset();
+        symbols.clear();
+    }
+
+    /**
+     * @brief Copies the arrays of a stream loaded from the cache out of the entry, so they can be changed.
+     *
+     * Identifier payloads are translated to symbol ids on the way, after which the entry is no longer needed.
+     */
+    void TokenStream::Resolve() {
+        if (!storage) return;
+
+        const auto own = [](auto&) {};
+        types.Modify(own);
+        offsets.Modify(own);
+        lexemeOffsets.Modify(own);
+        lengths.Modify(own);
+        payloads.Modify([this](std::vector<std::uint64_t>& owned) {
+            if (symbols.empty()) return;
+            for (std::size_t i = 0; i < owned.size(); i++) {
+                if (Type(i) == TokenType::IDENTIFIER) owned[i] = symbols[owned[i]];
+            }
+        });
+
+        storage.reset();
+        symbols.clear();
+    }
+
+    /**
+     * @brief Points the stream at a new copy of its source, such as the text after an edit.
+     *
+     * @param newSource The text the offsets now refer to. It must outlive the stream.
+     */
+    void TokenStream::Rebind(const std::string_view newSource) {
+        source = newSource;
+    }
+
+    /**
+     * @brief Replaces a range of tokens with the tokens of another stream over the same source.
+     *
+     * @param first The index of the first token to replace.
+     * @param count How many tokens to replace.
+     * @param replacement The tokens to put in their place.
+     */
+    void TokenStream::Splice(const std::size_t first, const std::size_t count, const TokenStream& replacement) {
+        if (replacement.storage) {
+            TokenStream resolved(replacement);
+            resolved.Resolve();
+            Splice(first, count, resolved);
+            return;
+        }
+        if (storage) Resolve();
+
+        const auto replace = [first, count](auto& column, const auto& with) {
+            column.Modify([&](auto& array) {
+                const auto at = array.begin() + static_cast<std::ptrdiff_t>(first);
+                if (with.Size() == count) {
+                    // The common case for typing inside a token: overwrite in place instead of moving the tail twice.
+                    std::copy(with.begin(), with.end(), at);
+                    return;
+                }
+                array.insert(array.erase(at, at + static_cast<std::ptrdiff_t>(count)), with.begin(), with.end());
+            });
+        };
+
+        replace(types, replacement.types);
+        replace(offsets, replacement.offsets);
+        replace(lexemeOffsets, replacement.lexemeOffsets);
+        replace(lengths, replacement.lengths);
+        replace(payloads, replacement.payloads);
+
+        if (detachedLexemes.empty() && replacement.detachedLexemes.empty()) return;
+
+        // Detached lexemes are keyed by index, so renumber the ones after the splice.
+        const auto shift = static_cast<std::int64_t>(replacement.Size()) - static_cast<std::int64_t>(count);
+        std::unordered_map<std::uint32_t, std::string> renumbered;
+        for (auto& [index, lexeme] : detachedLexemes) {
+            if (index < first) renumbered.emplace(index, std::move(lexeme));
+            else if (index >= first + count) renumbered.emplace(static_cast<std::uint32_t>(index + shift), std::move(lexeme));
+        }
+        for (const auto& [index, lexeme] : replacement.detachedLexemes) {
+            renumbered.emplace(static_cast<std::uint32_t>(first + index), lexeme);
+        }
+        detachedLexemes = std::move(renumbered);
+    }
+
+    /**
+     * @brief Moves every token from an index onwards by the same number of bytes, after text before them changed size.
+     *
+     * @param from The index of the first token to move.
+     * @param delta How many bytes to move them by.
+     */
+    void TokenStream::ShiftOffsets(const std::size_t from, const std::int64_t delta) {
+        const auto shift = static_cast<std::uint32_t>(delta); // Wraps for negative deltas, which unsigned addition undoes.
+        const auto move = [from, shift](std::vector<std::uint32_t>& array) {
+            for (std::size_t i = from; i < array.size(); i++) array[i] += shift;
+        };
+        if (storage) Resolve();
+        offsets.Modify(move);
+        lexemeOffsets.Modify(move);
+    }
+
+    /**
+     * @returns The text of the token at index.
+     */
+    std::string_view TokenStream::Lexeme(const std::size_t index) const {
+        if (!detachedLexemes.empty()) {
+            if (const auto detached = detachedLexemes.find(static_cast<std::uint32_t>(index)); detached != detachedLexemes.end()) {
+                return detached->second;
+            }
+        }
+        return source.substr(lexemeOffsets[index], lengths[index]);
+    }
+
+    /**
+     * @returns The token at index, reassembled into a Token.
+     */
+    Token TokenStream::operator[](const std::size_t index) const {
+        return {Type(index), Lexeme(index), offsets[index], Payload(index)};
+    }
+
+    /**
+     * @brief Looks ahead of a token without bounds checks on the caller's side.
+     *
+     * @param index The token to look from.
+     * @param ahead How many tokens further to look.
+     *
+     * @returns The type of the token ahead tokens after index, or END_OF_FILE past the end of the stream.
+     */
+    TokenType TokenStream::PeekType(const std::size_t index, const std::size_t ahead) const {
+        const std::size_t target = index + ahead;
+        return target < Size() ? Type(target) : TokenType::END_OF_FILE;
+    }
+
+    /**
+     * @brief Finds the next token of a type, scanning only the type array.
+     *
+     * @param type The type to look for.
+     * @param from The first index to look at.
+     *
+     * @returns The index of the token, or Size() if there is none.
+     */
+    std::size_t TokenStream::Find(const TokenType type, const std::size_t from) const {
+        if (from >= Size()) return Size();
+
+        const void* found = std::memchr(types.Data() + from, static_cast<std::uint8_t>(type), Size() - from);
+        return found == nullptr ? Size() : static_cast<std::size_t>(static_cast<const std::uint8_t*>(found) - types.Data());
+    }
+
+    /**
+     * @brief Finds the brace or parenthesis that closes the one at index, scanning only the type array.
+     *
+     * @param index The index of a LEFT_BRACE or LEFT_PAREN token.
+     *
+     * @returns The index of the matching closing token, or Size() if it is unbalanced or index is not an opener.
+     */
+    std::size_t TokenStream::FindMatching(const std::size_t index) const {
+        if (index >= Size()) return Size();
+
+        TokenType close;
+        switch (Type(index)) {
+            case TokenType::LEFT_BRACE: close = TokenType::RIGHT_BRACE; break;
+            case TokenType::LEFT_PAREN: close = TokenType::RIGHT_PAREN; break;
+            default: return Size();
+        }
+
+        const auto openType = types[index];
+        const auto closeType = static_cast<std::uint8_t>(close);
+        std::size_t depth = 0;
+
+        for (std::size_t i = index; i < Size(); i++) {
+            depth += types[i] == openType;
+            depth -= types[i] == closeType;
+            if (depth == 0) return i;
+        }
+
+        return Size();
+    }
+}
@@ -0,0 +1,165 @@
+#pragma once
+#ifndef TOKENSTREAM_H
+#define TOKENSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "interner.h"
+#include "token.h"
+#include "tokentype.h"
+
+namespace Lexer {
+    class SourceBuffer;
+
+    /**
+     * @brief A struct-of-arrays token container.
+     *
+     * Token types live in a dense array of bytes, separate from the offsets, lengths and decoded payloads, so
+     * passes that only look at types (brace matching, skipping to the end of a statement) touch one byte per token
+     * instead of a whole Token. Lexemes are stored as offsets into the source rather than pointers; the few lexemes
+     * that do not live in the source buffer are copied into a side table, so a stream only depends on its source.
+     *
+     * A stream loaded from the token cache does not copy the arrays: it reads them straight from the mapped entry,
+     * which it keeps alive, and copies them out only if it is edited.
+     */
+    class TokenStream {
+    private:
+        friend class TokenCache; // Reads and writes the arrays in bulk.
+
+        // One of the arrays. It is either owned or a read-only view of storage, and reads go through the same pointer
+        // either way. Only the stream decides when to copy a view out, so every change goes through Modify.
+        template <typename T>
+        class Column {
+        private:
+            std::vector<T> owned;
+            const T* items = nullptr;
+            std::size_t count = 0;
+            bool viewed = false;
+
+            void Sync() {
+                items = owned.data();
+                count = owned.size();
+            }
+        public:
+            Column() = default;
+            Column(const Column& other) : owned(other.owned), items(other.items), count(other.count), viewed(other.viewed) {
+                if (!viewed) Sync();
+            }
+            // Moving a vector keeps its buffer, so items stays valid.
+            Column(Column&& other) noexcept
+                : owned(std::move(other.owned)), items(other.items), count(other.count), viewed(other.viewed) {
+                other.Clear();
+            }
+            Column& operator=(Column other) noexcept {
+                std::swap(owned, other.owned);
+                std::swap(items, other.items);
+                std::swap(count, other.count);
+                std::swap(viewed, other.viewed);
+                return *this;
+            }
+
+            std::size_t Size() const { return count; }
+            const T* Data() const { return items; }
+            const T& operator[](const std::size_t index) const { return items[index]; }
+            const T* begin() const { return items; }
+            const T* end() const { return items + count; }
+            std::span<const T> Span() const { return {items, count}; }
+            bool Viewed() const { return viewed; }
+
+            void View(const std::span<const T> storage) {
+                owned.clear();
+                items = storage.data();
+                count = storage.size();
+                viewed = true;
+            }
+
+            void Push(const T& value) {
+                owned.push_back(value);
+                Sync();
+            }
+
+            void Reserve(const std::size_t capacity) {
+                owned.reserve(capacity);
+                Sync();
+            }
+
+            void Clear() {
+                owned.clear();
+                viewed = false;
+                Sync();
+            }
+
+            // Calls edit with the owned array, copying a view out first.
+            template <typename Edit>
+            void Modify(Edit&& edit) {
+                if (viewed) {
+                    owned.assign(items, items + count);
+                    viewed = false;
+                }
+                edit(owned);
+                Sync();
+            }
+        };
+
+        std::string_view source;
+        Column<std::uint8_t> types;
+        Column<std::uint32_t> offsets; // Where each token starts.
+        Column<std::uint32_t> lexemeOffsets; // Where each lexeme starts, which is past the quote for strings.
+        Column<std::uint32_t> lengths;
+        Column<std::uint64_t> payloads;
+        std::unordered_map<std::uint32_t, std::string> detachedLexemes; // Copies, by token index, so a stream is self-contained.
+
+        // Set only for a stream loaded from the cache. The columns view storage, and an identifier's payload is a
+        // number local to the entry that symbols translates, since symbol ids are only meaningful within one process.
+        std::shared_ptr<const SourceBuffer> storage;
+        std::vector<SymbolId> symbols;
+
+        void Resolve();
+    public:
+        TokenStream() = default;
+        explicit TokenStream(std::string_view source);
+
+        void Append(const Token& token);
+        void Append(TokenType type, std::uint32_t offset, std::uint32_t lexemeOffset, std::uint32_t length, std::uint64_t payload = 0);
+        void Reserve(std::size_t count);
+        void Clear();
+
+        // Editing, for incremental re-lexing
+        void Rebind(std::string_view newSource);
+        void Splice(std::size_t first, std::size_t count, const TokenStream& replacement);
+        void ShiftOffsets(std::size_t from, std::int64_t delta);
+
+        std::size_t Size() const { return types.Size(); }
+        bool Empty() const { return types.Size() == 0; }
+        std::string_view Source() const { return source; }
+
+        TokenType Type(const std::size_t index) const { return static_cast<TokenType>(types[index]); }
+        std::uint32_t Offset(const std::size_t index) const { return offsets[index]; }
+        std::uint32_t LexemeOffset(const std::size_t index) const { return lexemeOffsets[index]; }
+        std::uint32_t Length(const std::size_t index) const { return lengths[index]; }
+        std::uint64_t Payload(const std::size_t index) const {
+            if (symbols.empty() || Type(index) != TokenType::IDENTIFIER) return payloads[index];
+            return symbols[payloads[index]];
+        }
+        SymbolId Symbol(const std::size_t index) const { return static_cast<SymbolId>(Payload(index)); }
+        std::string_view Lexeme(std::size_t index) const;
+        Token operator[](std::size_t index) const;
+
+        TokenType PeekType(std::size_t index, std::size_t ahead = 1) const;
+        std::span<const std::uint8_t> Types() const { return types.Span(); }
+        std::span<const std::uint32_t> Offsets() const { return offsets.Span(); }
+
+        std::size_t Find(TokenType type, std::size_t from = 0) const;
+        std::size_t FindMatching(std::size_t index) const;
+    };
+}
+
+#endif //TOKENSTREAM_H
@@ -22,8 +22,10 @@ namespace Lexer {
         LEFT_PAREN, RIGHT_PAREN, //27-28
         LEFT_BRACE, RIGHT_BRACE, //29-30
         COMMA, COLON, SEMICOLON, ARROW, //31-34
+        // Trivia
+        COMMENT, // 35
         // Meta
-        END_OF_FILE, UNKNOWN // 35-36
+        END_OF_FILE, UNKNOWN // 36-37
     };
 }
 
@@ -0,0 +1,106 @@
+#pragma once
+#ifndef UNICODE_H
+#define UNICODE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#include "unicodetables.h"
+
+namespace Lexer {
+    /**
+     * @brief Decodes one UTF-8 sequence, rejecting overlong forms, surrogates and anything past U+10FFFF.
+     *
+     * @param text The text to decode from.
+     * @param position Where the sequence starts.
+     * @param codePoint Receives the decoded code point.
+     *
+     * @returns The length of the sequence in bytes, or 0 if it is not valid UTF-8.
+     */
+    constexpr std::size_t DecodeUtf8(const std::string_view text, const std::size_t position, std::uint32_t& codePoint) {
+        const auto byte = [&](const std::size_t i) { return static_cast<std::uint8_t>(text[position + i]); };
+        const std::size_t available = text.size() - position;
+        const std::uint8_t lead = byte(0);
+
+        if (lead < 0x80) {
+            codePoint = lead;
+            return 1;
+        }
+
+        std::size_t length = 0;
+        std::uint32_t minimum = 0;
+        if (lead >= 0xC2 && lead <= 0xDF) { length = 2; minimum = 0x80; codePoint = lead & 0x1F; }
+        else if (lead >= 0xE0 && lead <= 0xEF) { length = 3; minimum = 0x800; codePoint = lead & 0x0F; }
+        else if (lead >= 0xF0 && lead <= 0xF4) { length = 4; minimum = 0x10000; codePoint = lead & 0x07; }
+        else return 0;
+
+        if (length > available) return 0;
+        for (std::size_t i = 1; i < length; i++) {
+            if ((byte(i) & 0xC0) != 0x80) return 0;
+            codePoint = codePoint << 6 | (byte(i) & 0x3F);
+        }
+
+        if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) return 0;
+        return length;
+    }
+
+    /**
+     * @brief Writes a code point as UTF-8.
+     *
+     * @param codePoint A Unicode scalar value.
+     * @param out Where to write. Needs room for four bytes.
+     *
+     * @returns The number of bytes written.
+     */
+    constexpr std::size_t EncodeUtf8(const std::uint32_t codePoint, char* out) {
+        if (codePoint < 0x80) {
+            out[0] = static_cast<char>(codePoint);
+            return 1;
+        }
+        if (codePoint < 0x800) {
+            out[0] = static_cast<char>(0xC0 | codePoint >> 6);
+            out[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            return 2;
+        }
+        if (codePoint < 0x10000) {
+            out[0] = static_cast<char>(0xE0 | codePoint >> 12);
+            out[1] = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            out[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            return 3;
+        }
+        out[0] = static_cast<char>(0xF0 | codePoint >> 18);
+        out[1] = static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+        out[2] = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+        out[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        return 4;
+    }
+
+    namespace Unicode {
+        constexpr bool InRanges(const CodePointRange* first, const CodePointRange* last, const std::uint32_t codePoint) {
+            const CodePointRange* range = std::upper_bound(first, last, codePoint,
+                                                           [](const std::uint32_t value, const CodePointRange& candidate) {
+                                                               return value < candidate.first;
+                                                           });
+            return range != first && codePoint <= (range - 1)->last;
+        }
+    }
+
+    /**
+     * @returns Whether a non-ASCII code point may start an identifier (Unicode XID_Start).
+     */
+    constexpr bool IsXidStart(const std::uint32_t codePoint) {
+        return Unicode::InRanges(std::begin(xidStartRanges), std::end(xidStartRanges), codePoint);
+    }
+
+    /**
+     * @returns Whether a non-ASCII code point may continue an identifier (Unicode XID_Continue).
+     */
+    constexpr bool IsXidContinue(const std::uint32_t codePoint) {
+        return Unicode::InRanges(std::begin(xidContinueRanges), std::end(xidContinueRanges), codePoint);
+    }
+}
+
+#endif //UNICODE_H
@@ -0,0 +1,86 @@
+#pragma once
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions so tests and benchmarks can count heap allocations. It defines the
+// replacements, so include it in exactly one translation unit of each test binary.
+//
+// Every form of operator new allocates with std::malloc or std::aligned_alloc and every form of operator delete frees
+// with std::free, so any pairing the standard allows is consistent. The replacements are kept out of line: once the
+// compiler inlines a delete into a caller, it sees std::free called on memory from operator new and warns
+// (-Wmismatched-new-delete), even though the pair matches.
+
+// Heap allocations made through operator new since the program started.
+inline std::atomic<std::size_t> allocationCount{0};
+
+namespace AllocationCounter {
+    inline void* Allocate(const std::size_t size) noexcept {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    inline void* AllocateAligned(const std::size_t size, const std::align_val_t alignment) noexcept {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        // aligned_alloc wants a size that is a multiple of the alignment.
+        const auto align = static_cast<std::size_t>(alignment);
+        const std::size_t rounded = (size == 0 ? align : (size + align - 1) / align * align);
+        return std::aligned_alloc(align, rounded);
+    }
+
+    inline void* OrThrow(void* memory) {
+        if (memory == nullptr) throw std::bad_alloc();
+        return memory;
+    }
+}
+
+[[gnu::noinline]] void* operator new(const std::size_t size) {
+    return AllocationCounter::OrThrow(AllocationCounter::Allocate(size));
+}
+
+[[gnu::noinline]] void* operator new[](const std::size_t size) {
+    return AllocationCounter::OrThrow(AllocationCounter::Allocate(size));
+}
+
+[[gnu::noinline]] void* operator new(const std::size_t size, const std::nothrow_t&) noexcept {
+    return AllocationCounter::Allocate(size);
+}
+
+[[gnu::noinline]] void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept {
+    return AllocationCounter::Allocate(size);
+}
+
+[[gnu::noinline]] void* operator new(const std::size_t size, const std::align_val_t alignment) {
+    return AllocationCounter::OrThrow(AllocationCounter::AllocateAligned(size, alignment));
+}
+
+[[gnu::noinline]] void* operator new[](const std::size_t size, const std::align_val_t alignment) {
+    return AllocationCounter::OrThrow(AllocationCounter::AllocateAligned(size, alignment));
+}
+
+[[gnu::noinline]] void* operator new(const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocationCounter::AllocateAligned(size, alignment);
+}
+
+[[gnu::noinline]] void* operator new[](const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocationCounter::AllocateAligned(size, alignment);
+}
+
+[[gnu::noinline]] void operator delete(void* memory) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { std::free(memory); }
+
+#endif //ALLOCATIONCOUNTER_H
@@ -0,0 +1,176 @@
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "../lib/catch.hpp"
+#include "../src/lexer/lexer.h"
+#include "../src/lexer/sourcebuffer.h"
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Throughput benchmarks for Lexer::Tokenize over generated corpora.
+//
+// Every corpus is deterministic, so numbers taken before and after a lexer change are comparable. The sizes from
+// 1 KB to 16 MB always run; the 256 MB and 1 GB corpora only run when VIREO_BENCH_LARGE is set, since they need
+// several gigabytes of memory for the token vector. After the run, a table gives MB/s and tokens/s from Catch's
+// mean time, and allocations per token from a counted pass after a warm-up pass.
+
+namespace {
+    enum class Corpus { IDENTIFIERS, LITERALS, STRINGS, NESTED };
+
+    constexpr const char* corpusNames[] = {"identifiers", "literals", "strings", "nested"};
+
+    struct Measurement {
+        std::size_t bytes;
+        std::size_t tokens;
+        std::size_t allocations;
+    };
+
+    // What each benchmark lexed, by benchmark name, so the listener can turn its mean time into throughput.
+    std::map<std::string, Measurement>& Measurements() {
+        static std::map<std::string, Measurement> measurements;
+        return measurements;
+    }
+
+    std::string Identifier(std::mt19937_64& random) {
+        static constexpr char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+        static constexpr char tail[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+
+        std::string name(1, letters[random() % (sizeof(letters) - 1)]);
+        const std::size_t length = random() % 16;
+        for (std::size_t i = 0; i < length; ++i) name += tail[random() % (sizeof(tail) - 1)];
+        return name;
+    }
+
+    std::string Number(std::mt19937_64& random) {
+        std::string number = std::to_string(random() % 1000000000);
+        if (random() % 2 == 0) number += "." + std::to_string(random() % 100000);
+        return number;
+    }
+
+    std::string String(std::mt19937_64& random) {
+        static constexpr const char* pieces[] = {"hello", " ", "world", "\\n", "\\t", "\\\"", "lorem ipsum", "42"};
+
+        std::string text = "\"";
+        const std::size_t length = 1 + random() % 12;
+        for (std::size_t i = 0; i < length; ++i) text += pieces[random() % std::size(pieces)];
+        return text + "\"";
+    }
+
+    /**
+     * @brief Appends one statement or block of the given corpus to the text.
+     */
+    void AppendFragment(std::string& text, const Corpus corpus, std::mt19937_64& random) {
+        switch (corpus) {
+            case Corpus::IDENTIFIERS:
+                text += "var " + Identifier(random) + ": int = " + Identifier(random) + " + " + Identifier(random) + " * " +
+                    Identifier(random) + ";\n";
+                break;
+            case Corpus::LITERALS:
+                text += Number(random) + ", " + Number(random) + ", " + Number(random) + ", " + Number(random) + ";\n";
+                break;
+            case Corpus::STRINGS:
+                text += "var s: string = " + String(random) + " + " + String(random) + ";\n";
+                break;
+            case Corpus::NESTED: {
+                const std::size_t depth = 8 + random() % 56;
+                for (std::size_t i = 0; i < depth; ++i) text += "if (x) { (";
+                text += "y";
+                for (std::size_t i = 0; i < depth; ++i) text += ") }";
+                text += "\n";
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Generates a corpus of about the given size, always the same for the same arguments.
+     *
+     * @param corpus What kind of source to generate.
+     * @param size The size in bytes. The text stops at the last whole line that fits.
+     */
+    std::string GenerateCorpus(const Corpus corpus, const std::size_t size) {
+        std::mt19937_64 random(0x5649524500000000 + static_cast<std::uint64_t>(corpus));
+        std::string text;
+        text.reserve(size + 4096);
+        while (text.size() < size) AppendFragment(text, corpus, random);
+
+        const std::size_t lastLine = text.rfind('\n', size - 1);
+        text.resize(lastLine == std::string::npos ? size : lastLine + 1);
+        return text;
+    }
+
+    std::string SizeName(const std::size_t size) {
+        if (size >= 1 << 30) return std::to_string(size >> 30) + " GB";
+        if (size >= 1 << 20) return std::to_string(size >> 20) + " MB";
+        return std::to_string(size >> 10) + " KB";
+    }
+
+    // Turns each benchmark's mean time into throughput, and prints the table once every benchmark has run.
+    struct ThroughputListener : Catch::TestEventListenerBase {
+        using TestEventListenerBase::TestEventListenerBase;
+
+        std::vector<std::string> rows;
+
+        void benchmarkEnded(const Catch::BenchmarkStats<>& stats) override {
+            const auto found = Measurements().find(stats.info.name);
+            if (found == Measurements().end()) return;
+
+            const Measurement& measurement = found->second;
+            const double seconds = stats.mean.point.count() / 1e9;
+            char row[160];
+            std::snprintf(row, sizeof(row), "%-24s %12.1f %14.2f %14.4f", stats.info.name.c_str(),
+                          measurement.bytes / seconds / 1e6, measurement.tokens / seconds / 1e6,
+                          static_cast<double>(measurement.allocations) / static_cast<double>(measurement.tokens));
+            rows.emplace_back(row);
+        }
+
+        void testRunEnded(const Catch::TestRunStats&) override {
+            if (rows.empty()) return;
+
+            std::printf("\n%-24s %12s %14s %14s\n", "benchmark", "MB/s", "Mtokens/s", "allocs/token");
+            for (const std::string& row : rows) std::printf("%s\n", row.c_str());
+        }
+    };
+}
+
+CATCH_REGISTER_LISTENER(ThroughputListener)
+
+int main(int argc, char* argv[]) {
+    return Catch::Session().run(argc, argv);
+}
+
+TEST_CASE("Tokenize throughput", "[bench]") {
+    std::vector<std::size_t> sizes = {1 << 10, 64 << 10, 1 << 20, 16 << 20};
+    if (std::getenv("VIREO_BENCH_LARGE")) {
+        sizes.push_back(std::size_t{256} << 20);
+        sizes.push_back(std::size_t{1} << 30);
+    }
+
+    for (const Corpus corpus : {Corpus::IDENTIFIERS, Corpus::LITERALS, Corpus::STRINGS, Corpus::NESTED}) {
+        for (const std::size_t size : sizes) {
+            const std::string text = GenerateCorpus(corpus, size);
+            const std::string name = std::string(corpusNames[static_cast<int>(corpus)]) + " " + SizeName(size);
+
+            // A view, so the corpus is not copied; the lexer only has to outlive the benchmark.
+            Lexer::Lexer lexer(Lexer::SourceBuffer::View(text));
+
+            // A first pass warms the caches, the allocator and the global interner, whose one-off insertions would
+            // otherwise be charged to every token. Allocations are counted on a second pass over the same input.
+            const std::size_t tokens = lexer.Tokenize().size();
+            const std::size_t before = allocationCount.load();
+            lexer.Tokenize();
+            Measurements()[name] = {text.size(), tokens, allocationCount.load() - before};
+
+            BENCHMARK(std::string(name)) {
+                return lexer.Tokenize();
+            };
+        }
+    }
+}
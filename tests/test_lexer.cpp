@@ -3,6 +3,72 @@
 #include "../src/lexer/lexer.h"
 #include "../src/lexer/token.h"
 #include "../src/lexer/tokentype.h"
+#include "../src/lexer/sourcebuffer.h"
+#include "../src/lexer/charscan.h"
+#include "../src/lexer/keywords.h"
+#include "../src/lexer/scantables.h"
+#include "../src/lexer/parallellexer.h"
+#include "../src/lexer/threadpool.h"
+#include "../src/lexer/tokenstream.h"
+#include "../src/lexer/lineindex.h"
+#include "../src/lexer/incrementallexer.h"
+#include "../src/lexer/interner.h"
+#include "../src/lexer/arena.h"
+#include "../src/lexer/batchlexer.h"
+#include "../src/lexer/unicode.h"
+#include "../src/lexer/tokencache.h"
+#include "../src/lexer/spscring.h"
+#include "../src/lexer/pipelinedlexer.h"
+#include "../src/lexer/perfcounters.h"
+#include "../src/lexer/timetrace.h"
+#include "../src/lexer/streamlexer.h"
+#include "../src/lexer/statictokens.h"
+#include "allocationcounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <sstream>
+#include <thread>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace {
+    // A file under the system's temporary directory that is removed when it goes out of scope, even if a test fails.
+    struct TemporaryFile {
+        std::filesystem::path path;
+
+        TemporaryFile(const std::string& name, const std::string_view contents)
+            : path(std::filesystem::temp_directory_path() / name) {
+            std::ofstream file(path, std::ios::binary);
+            file << contents;
+        }
+
+        ~TemporaryFile() {
+            std::error_code ignored;
+            std::filesystem::remove(path, ignored);
+        }
+
+        TemporaryFile(const TemporaryFile&) = delete;
+        TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+        std::string Path() const { return path.string(); }
+    };
+}
+
+// Lexes during static initialization, which may run before charscan.cpp's own initializers have.
+static const std::string staticInitSource = "var   x = \"s\";";
+static const std::vector<Lexer::Token> staticInitTokens =
+    Lexer::Lexer(Lexer::SourceBuffer::View(staticInitSource)).Tokenize();
 
 int main(int argc, char* argv[]) {
     Catch::Session session;
@@ -185,4 +251,1265 @@ TEST_CASE("Lexer parses a small program correctly", "[lexer][demo]") {
              << ", got " << static_cast<int>(tokens[i].type));
         REQUIRE(tokens[i].type == expected[i]);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Lexer lexemes are views into the source buffer", "[lexer][lexeme]") {
+    std::string input = "var name = \"hello\";";
+    Lexer::Lexer lexer(input, false);
+    auto tokens = lexer.Tokenize();
+
+    REQUIRE(tokens[0].lexeme == "var");
+    REQUIRE(tokens[1].lexeme == "name");
+    REQUIRE(tokens[2].lexeme == "=");
+    REQUIRE(tokens[3].type == Lexer::TokenType::STRING_LITERAL);
+    REQUIRE(tokens[3].lexeme == "hello");
+    REQUIRE(tokens[4].lexeme == ";");
+
+    // Each lexeme points into the same buffer, one after another, rather than into separate allocations.
+    REQUIRE(tokens[1].lexeme.data() == tokens[0].lexeme.data() + 4);
+    REQUIRE(tokens[3].lexeme.data() == tokens[2].lexeme.data() + 3);
+}
+
+TEST_CASE("Lexer reads source files through a memory mapping", "[lexer][file]") {
+    const TemporaryFile source("vireo_lexer_test_source.vireo", "var x: int = 10;\n");
+    const std::string path = source.Path();
+
+    const Lexer::SourceBuffer buffer = Lexer::SourceBuffer::FromFile(path);
+    REQUIRE(buffer.Text() == "var x: int = 10;\n");
+#if defined(__unix__) || defined(__APPLE__)
+    REQUIRE(buffer.IsMapped());
+#endif
+
+    Lexer::Lexer lexer(path, true);
+    auto tokens = lexer.Tokenize();
+    REQUIRE(tokens.size() == 8);
+    REQUIRE(tokens[0].type == Lexer::TokenType::VAR);
+    REQUIRE(tokens[5].lexeme == "10");
+}
+
+TEST_CASE("Lexer reports missing source files", "[lexer][file][error]") {
+    REQUIRE_THROWS_AS(Lexer::Lexer("this/file/does/not/exist.vireo", true), std::system_error);
+    REQUIRE_THROWS_AS(Lexer::Lexer::ConvertSourceToString("this/file/does/not/exist.vireo"), std::system_error);
+}
+
+TEST_CASE("Lexer reads empty files and pipes without mapping them", "[lexer][file]") {
+    {
+        const TemporaryFile file("vireo_lexer_test_empty.vireo", "");
+        const Lexer::SourceBuffer empty = Lexer::SourceBuffer::FromFile(file.Path());
+        REQUIRE_FALSE(empty.IsMapped());
+        REQUIRE(empty.Text().empty());
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    REQUIRE(write(fds[1], "if", 2) == 2);
+    close(fds[1]);
+
+    const Lexer::SourceBuffer piped = Lexer::SourceBuffer::FromFile("/dev/fd/" + std::to_string(fds[0]));
+    close(fds[0]);
+    REQUIRE_FALSE(piped.IsMapped());
+    REQUIRE(piped.Text() == "if");
+#endif
+}
+
+TEST_CASE("Lexer streams tokens one at a time", "[lexer][stream]") {
+    std::string input = "var x = 1;";
+    Lexer::Lexer lexer(input, false);
+
+    REQUIRE(lexer.PeekToken().type == Lexer::TokenType::VAR);
+    REQUIRE(lexer.NextToken().type == Lexer::TokenType::VAR);
+    REQUIRE(lexer.NextToken().lexeme == "x");
+    REQUIRE(lexer.PeekToken().type == Lexer::TokenType::ASSIGN);
+    REQUIRE(lexer.PeekToken().type == Lexer::TokenType::ASSIGN);
+    REQUIRE(lexer.NextToken().type == Lexer::TokenType::ASSIGN);
+
+    std::vector<Lexer::TokenType> rest;
+    for (const Lexer::Token& token : lexer) {
+        rest.push_back(token.type);
+    }
+
+    REQUIRE(rest == std::vector{Lexer::TokenType::INT_LITERAL, Lexer::TokenType::SEMICOLON, Lexer::TokenType::END_OF_FILE});
+    REQUIRE(lexer.NextToken().type == Lexer::TokenType::END_OF_FILE);
+}
+
+TEST_CASE("Lexer streaming matches Tokenize", "[lexer][stream]") {
+    std::string input = "function add -> int {\nreturn x + y;\n}";
+    Lexer::Lexer batch(input, false);
+    Lexer::Lexer streaming(input, false);
+
+    const auto tokens = batch.Tokenize();
+    size_t i = 0;
+    for (const Lexer::Token& token : streaming) {
+        REQUIRE(i < tokens.size());
+        REQUIRE(token.type == tokens[i].type);
+        REQUIRE(token.lexeme == tokens[i].lexeme);
+        REQUIRE(token.offset == tokens[i].offset);
+        ++i;
+    }
+    REQUIRE(i == tokens.size());
+}
+
+TEST_CASE("Lexer scan kernels agree on long runs", "[lexer][simd]") {
+    std::string input;
+    for (int i = 0; i < 40; ++i) {
+        input += std::string(i, ' ') + "\n\t\r" + std::string(i % 7, '\n');
+        input += "identifier_" + std::string(i * 3, 'a') + std::to_string(i) + "Z ";
+        input += std::string(i * 2 + 1, '7') + "." + std::string(i + 1, '3') + "+" + std::string(i, '9') + ";";
+        input += "\"" + std::string(i * 5, 's') + (i % 3 ? "\\\"" : "") + std::string(i, 'q') + "\" ";
+    }
+
+    const Lexer::ScanKernel original = Lexer::ActiveScanKernel();
+    REQUIRE(Lexer::ForceScanKernel(Lexer::ScanKernel::SCALAR));
+    Lexer::Lexer scalarLexer(input, false);
+    const auto expected = scalarLexer.Tokenize();
+    REQUIRE(scalarLexer.Locate(expected.back()).line > 40);
+
+    for (const auto kernel : {Lexer::ScanKernel::SSE2, Lexer::ScanKernel::AVX2}) {
+        if (!Lexer::ForceScanKernel(kernel)) continue;
+
+        Lexer::Lexer lexer(input, false);
+        const auto tokens = lexer.Tokenize();
+        REQUIRE(tokens.size() == expected.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            INFO("Kernel " << static_cast<int>(kernel) << ", token " << i);
+            REQUIRE(tokens[i].type == expected[i].type);
+            REQUIRE(tokens[i].lexeme == expected[i].lexeme);
+            REQUIRE(tokens[i].offset == expected[i].offset);
+            REQUIRE(lexer.Locate(tokens[i]).line == scalarLexer.Locate(expected[i]).line);
+        }
+    }
+
+    Lexer::ForceScanKernel(original);
+}
+
+TEST_CASE("Lexer resolves lines and columns lazily", "[lexer][lines]") {
+    std::string input = "a" + std::string(100, '\n') + "b \r\n\t c" + std::string(33, ' ') + "\n d";
+    Lexer::Lexer lexer(input, false);
+    auto tokens = lexer.Tokenize();
+
+    REQUIRE(tokens[0].offset == 0);
+    REQUIRE(tokens[1].offset == 101);
+
+    REQUIRE(lexer.Locate(tokens[0]).line == 1);
+    REQUIRE(lexer.Locate(tokens[0]).column == 1);
+    REQUIRE(lexer.Locate(tokens[1]).line == 101);
+    REQUIRE(lexer.Locate(tokens[1]).column == 1);
+    REQUIRE(lexer.Locate(tokens[2]).line == 102);
+    REQUIRE(lexer.Locate(tokens[2]).column == 3);
+    REQUIRE(lexer.Locate(tokens[3]).line == 103);
+    REQUIRE(lexer.Locate(tokens[3]).column == 2);
+    REQUIRE(lexer.Locate(tokens.back()).line == 103);
+}
+
+TEST_CASE("Line index agrees with a byte-by-byte count", "[lexer][lines]") {
+    std::string input;
+    for (int i = 0; i < 300; ++i) {
+        input += std::string(i % 37, 'x') + (i % 5 == 0 ? "\n\n" : "\n");
+    }
+
+    const Lexer::LineIndex index(input);
+    int line = 1;
+    int column = 1;
+    for (size_t offset = 0; offset < input.size(); ++offset) {
+        const Lexer::SourceLocation location = index.Locate(static_cast<std::uint32_t>(offset));
+        REQUIRE(location.line == line);
+        REQUIRE(location.column == column);
+
+        if (input[offset] == '\n') {
+            line++;
+            column = 1;
+        } else {
+            column++;
+        }
+    }
+    REQUIRE(index.LineCount() == static_cast<size_t>(line));
+}
+
+TEST_CASE("Keyword lookup is resolved at compile time", "[lexer][keywords]") {
+    static_assert(Lexer::LookupKeyword("function") == Lexer::TokenType::FUNCTION);
+    static_assert(Lexer::LookupKeyword("else_if") == Lexer::TokenType::ELSE_IF);
+    static_assert(Lexer::LookupKeyword("false") == Lexer::TokenType::BOOL_LITERAL);
+    static_assert(Lexer::LookupKeyword("functions") == Lexer::TokenType::IDENTIFIER);
+
+    for (const Lexer::Keyword& keyword : Lexer::keywords) {
+        REQUIRE(Lexer::LookupKeyword(keyword.spelling) == keyword.type);
+    }
+
+    for (const std::string_view word : {"i", "iff", "elsewhere", "Int", "fox", "var_", "x", "truee", "fals"}) {
+        REQUIRE(Lexer::LookupKeyword(word) == Lexer::TokenType::IDENTIFIER);
+    }
+}
+
+TEST_CASE("Scanner tables are generated from the token specification", "[lexer][tables]") {
+    const Lexer::ScanTables::Dfa& dfa = Lexer::ScanTables::dfa;
+
+    for (const Lexer::TokenSpec& spec : Lexer::tokenSpecs) {
+        if (spec.kind != Lexer::TokenKind::PUNCTUATOR) continue;
+
+        std::uint8_t state = Lexer::ScanTables::START;
+        for (const char c : spec.spelling) {
+            state = dfa.Next(state, c);
+            REQUIRE(state != Lexer::ScanTables::DEAD);
+        }
+        REQUIRE(dfa.accepts[state] == spec.type);
+
+        Lexer::Lexer lexer(std::string(spec.spelling), false);
+        auto tokens = lexer.Tokenize();
+        REQUIRE(tokens.size() == 2);
+        REQUIRE(tokens[0].type == spec.type);
+        REQUIRE(tokens[0].lexeme == spec.spelling);
+    }
+}
+
+TEST_CASE("Lexer uses the longest punctuator match", "[lexer][tables]") {
+    std::string input = "=== ->- &&& |a &";
+    Lexer::Lexer lexer(input, false);
+    auto tokens = lexer.Tokenize();
+
+    std::vector<Lexer::TokenType> expected = {
+        Lexer::TokenType::EQUAL_TO, Lexer::TokenType::ASSIGN,
+        Lexer::TokenType::ARROW, Lexer::TokenType::MINUS,
+        Lexer::TokenType::AND, Lexer::TokenType::UNKNOWN,
+        Lexer::TokenType::UNKNOWN, Lexer::TokenType::IDENTIFIER,
+        Lexer::TokenType::UNKNOWN,
+        Lexer::TokenType::END_OF_FILE
+    };
+
+    REQUIRE(tokens.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        INFO("At token index " << i);
+        REQUIRE(tokens[i].type == expected[i]);
+    }
+    REQUIRE(tokens[5].lexeme == "&");
+}
+
+TEST_CASE("Scan kernels work from another translation unit's static initializers", "[lexer][simd]") {
+    REQUIRE(staticInitTokens.size() == 6);
+    REQUIRE(staticInitTokens[2].type == Lexer::TokenType::ASSIGN);
+    REQUIRE(staticInitTokens[3].lexeme == "s");
+}
+
+TEST_CASE("Parallel lexer matches the sequential lexer at every chunk boundary", "[lexer][parallel]") {
+    std::string input =
+        "function add -> int {\n"
+        "  var s: string = \"a -> b == c && \n d || e\";\n"
+        "  if x == 10 && y || z { return 12.5 * 3; }\n"
+        "  var long_identifier_name = 123456789;  \t\r\n"
+        "  var e = \"bad \\q escape \\\" 99999999999999999999 \\u{110000}\";\n"
+        "  // line comment with \"quote -> and 99999999999999999999\n"
+        "  x = a / b /* block \"comment\" // \n spanning */ / c;\n"
+        "  \"unterminated -> ==";
+
+    Lexer::Lexer sequential(input, false);
+    const auto expected = sequential.Tokenize();
+    REQUIRE(sequential.Diagnostics().size() == 3);
+
+    Lexer::ThreadPool pool(4);
+    for (size_t chunkSize = 1; chunkSize <= input.size(); ++chunkSize) {
+        Lexer::ParallelLexer parallel(input, false, chunkSize);
+        const auto tokens = parallel.Tokenize(pool);
+
+        INFO("Chunk size " << chunkSize);
+        REQUIRE(tokens.size() == expected.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            INFO("At token index " << i);
+            REQUIRE(tokens[i].type == expected[i].type);
+            REQUIRE(tokens[i].lexeme == expected[i].lexeme);
+            REQUIRE(tokens[i].offset == expected[i].offset);
+        }
+
+        REQUIRE(parallel.Diagnostics().size() == sequential.Diagnostics().size());
+        for (size_t i = 0; i < sequential.Diagnostics().size(); ++i) {
+            REQUIRE(parallel.Diagnostics()[i].kind == sequential.Diagnostics()[i].kind);
+            REQUIRE(parallel.Diagnostics()[i].offset == sequential.Diagnostics()[i].offset);
+        }
+    }
+}
+
+TEST_CASE("Parallel lexer handles large generated sources", "[lexer][parallel]") {
+    std::string input;
+    for (int i = 0; i < 2000; ++i) {
+        input += "var v" + std::to_string(i) + ": int = " + std::to_string(i * 7) + ";\n";
+        if (i % 13 == 0) input += "var s: string = \"{ -> } == \n && ||\";\n";
+    }
+
+    Lexer::Lexer sequential(input, false);
+    const auto expected = sequential.Tokenize();
+
+    Lexer::ThreadPool pool(3);
+    Lexer::ParallelLexer parallel(input, false, 4096);
+    const auto tokens = parallel.Tokenize(pool);
+
+    REQUIRE(tokens.size() == expected.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        REQUIRE(tokens[i].type == expected[i].type);
+        REQUIRE(tokens[i].lexeme == expected[i].lexeme);
+        REQUIRE(tokens[i].offset == expected[i].offset);
+    }
+}
+
+TEST_CASE("Parallel lexer starts chunks cut inside literals where code resumes", "[lexer][parallel]") {
+    // Mostly long string literals with comment openers and escaped quotes inside, so most cuts land in a string.
+    std::string input;
+    for (int i = 0; i < 400; ++i) {
+        input += "s" + std::to_string(i) + " = \"" + std::string(150, 'q') + " // not a comment /* nor this \\\" " +
+            std::string(i % 37, 'z') + "\";\n";
+        if (i % 50 == 0) input += "/* a \"quoted\" comment */ // and a \"line\" one\n";
+    }
+
+    Lexer::Lexer sequential(input, false);
+    const auto expected = sequential.Tokenize();
+
+    Lexer::ThreadPool pool(4);
+    for (const size_t chunkSize : {97, 1000, 4096}) {
+        INFO("Chunk size " << chunkSize);
+        Lexer::ParallelLexer parallel(input, false, chunkSize);
+        const auto tokens = parallel.Tokenize(pool);
+
+        REQUIRE(tokens.size() == expected.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            REQUIRE(tokens[i].type == expected[i].type);
+            REQUIRE(tokens[i].offset == expected[i].offset);
+        }
+
+        // With the right entry state, stitching a chunk takes at most a couple of tokens, not a rescan of the chunk.
+        REQUIRE(parallel.ResyncedTokens() <= 2 * (input.size() / chunkSize + 1));
+    }
+}
+
+TEST_CASE("Token stream stores the same tokens as Tokenize", "[lexer][tokenstream]") {
+    std::string input = "function add -> int {\nvar s: string = \"hi\";\nreturn (x + y);\n}";
+    Lexer::Lexer batch(input, false);
+    Lexer::Lexer streaming(input, false);
+
+    const auto tokens = batch.Tokenize();
+    const Lexer::TokenStream stream = streaming.TokenizeStream();
+
+    REQUIRE(stream.Size() == tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        REQUIRE(stream.Type(i) == tokens[i].type);
+        REQUIRE(stream.Lexeme(i) == tokens[i].lexeme);
+        REQUIRE(stream.Offset(i) == tokens[i].offset);
+        REQUIRE(stream[i].lexeme == tokens[i].lexeme);
+    }
+
+    REQUIRE(stream.PeekType(0) == Lexer::TokenType::IDENTIFIER);
+    REQUIRE(stream.PeekType(stream.Size() - 1, 5) == Lexer::TokenType::END_OF_FILE);
+}
+
+TEST_CASE("Token stream scans types without touching lexemes", "[lexer][tokenstream]") {
+    std::string input = "{ a; { (b + (c)); } { } } ; (";
+    Lexer::Lexer lexer(input, false);
+    const Lexer::TokenStream stream = lexer.TokenizeStream();
+
+    REQUIRE(stream.FindMatching(0) == 15);
+    REQUIRE(stream.FindMatching(3) == 12);
+    REQUIRE(stream.FindMatching(4) == 10);
+    REQUIRE(stream.FindMatching(13) == 14);
+    REQUIRE(stream.FindMatching(17) == stream.Size());
+    REQUIRE(stream.FindMatching(1) == stream.Size());
+
+    REQUIRE(stream.Find(Lexer::TokenType::SEMICOLON) == 2);
+    REQUIRE(stream.Find(Lexer::TokenType::SEMICOLON, 3) == 11);
+    REQUIRE(stream.Find(Lexer::TokenType::ARROW) == stream.Size());
+}
+
+TEST_CASE("Token stream keeps lexemes that are not in the source", "[lexer][tokenstream]") {
+    const std::string source = "a b";
+    const std::string rewritten = "rewritten";
+    Lexer::TokenStream stream(source);
+
+    stream.Append(Lexer::Token(Lexer::TokenType::IDENTIFIER, std::string_view(source).substr(0, 1), 0));
+    stream.Append(Lexer::Token(Lexer::TokenType::STRING_LITERAL, rewritten, 1));
+    stream.Append(Lexer::Token(Lexer::TokenType::IDENTIFIER, std::string_view(source).substr(2, 1), 2));
+
+    REQUIRE(stream.Lexeme(0) == "a");
+    REQUIRE(stream.Lexeme(1) == "rewritten");
+    REQUIRE(stream.Lexeme(2) == "b");
+}
+
+TEST_CASE("Incremental lexer re-lexes only around an edit", "[lexer][incremental]") {
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += "var v" + std::to_string(i) + ": int = " + std::to_string(i) + ";\n";
+    }
+
+    Lexer::IncrementalLexer incremental(text);
+    const size_t before = incremental.Tokens().Size();
+
+    // Rename v100 to v100x.
+    const auto offset = static_cast<std::uint32_t>(text.find("v100") + 4);
+    text.insert(offset, "x");
+    const Lexer::TokenRange changed = incremental.ApplyEdit(text, {offset, 0, 1});
+
+    REQUIRE(incremental.Tokens().Size() == before);
+    REQUIRE(changed.removedCount <= 3);
+    REQUIRE(changed.insertedCount == changed.removedCount);
+
+    bool renamed = false;
+    for (size_t i = changed.first; i < changed.first + changed.insertedCount; ++i) {
+        renamed |= incremental.Tokens().Lexeme(i) == "v100x";
+    }
+    REQUIRE(renamed);
+}
+
+TEST_CASE("Incremental lexer matches a full re-lex after random edits", "[lexer][incremental]") {
+    const std::vector<std::string> fragments = {
+        " ", "\n", "\"", "-", ">", "=", "&", "|", "1", ".", "5", "x", "if", "var", "{", "}", "\"str\"", "12.5", "->", "==",
+        "\xC3\xA9", "\xC3", "\xE2\x82\xAC", "/", "//", "/*", "*/"
+    };
+
+    std::string text = "function f -> int {\n  var s: string = \"a b\";\n  if x == 1.5 && y { return -> 42; }\n}\n";
+    Lexer::IncrementalLexer incremental(text);
+    std::mt19937 random(1234);
+
+    for (int edit = 0; edit < 500; ++edit) {
+        const auto offset = static_cast<std::uint32_t>(random() % (text.size() + 1));
+        const auto removed = static_cast<std::uint32_t>(std::min<size_t>(random() % 4, text.size() - offset));
+        const std::string& inserted = fragments[random() % fragments.size()];
+
+        text.replace(offset, removed, inserted);
+        incremental.ApplyEdit(text, {offset, removed, static_cast<std::uint32_t>(inserted.size())});
+
+        Lexer::Lexer full(text, false);
+        const auto expected = full.Tokenize();
+        const Lexer::TokenStream& tokens = incremental.Tokens();
+
+        INFO("Edit " << edit << ": \"" << text << "\"");
+        REQUIRE(tokens.Size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            REQUIRE(tokens.Type(i) == expected[i].type);
+            REQUIRE(tokens.Offset(i) == expected[i].offset);
+            REQUIRE(tokens.Lexeme(i) == expected[i].lexeme);
+        }
+    }
+}
+
+TEST_CASE("Identifiers carry interned symbol ids", "[lexer][interner]") {
+    Lexer::Lexer first("var count = count + total;", false);
+    Lexer::Lexer second("total(count)", false);
+    const auto a = first.Tokenize();
+    const auto b = second.Tokenize();
+
+    REQUIRE(a[0].Symbol() == 0); // Keywords are not interned.
+    REQUIRE(a[1].Symbol() != 0);
+    REQUIRE(a[1].Symbol() == a[3].Symbol());
+    REQUIRE(a[1].Symbol() != a[5].Symbol());
+    REQUIRE(b[0].Symbol() == a[5].Symbol());
+    REQUIRE(b[2].Symbol() == a[1].Symbol());
+    REQUIRE(Lexer::Interner::Global().Spelling(a[5].Symbol()) == "total");
+}
+
+TEST_CASE("Interner gives every thread the same ids", "[lexer][interner]") {
+    Lexer::Interner interner;
+    constexpr int threadCount = 4;
+    constexpr int wordCount = 2000;
+    std::vector<std::vector<Lexer::SymbolId>> ids(threadCount, std::vector<Lexer::SymbolId>(wordCount));
+
+    const int strides[threadCount] = {1, 3, 7, 9}; // Coprime with wordCount, so each thread visits every word once.
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < wordCount; ++i) {
+                const int word = (i * strides[t]) % wordCount; // Each thread interns the words in a different order.
+                ids[t][word] = interner.Intern("word" + std::to_string(word));
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    REQUIRE(interner.Size() == wordCount);
+    for (int i = 0; i < wordCount; ++i) {
+        REQUIRE(ids[0][i] != 0);
+        for (int t = 1; t < threadCount; ++t) {
+            REQUIRE(ids[t][i] == ids[0][i]);
+        }
+        REQUIRE(interner.Spelling(ids[0][i]) == "word" + std::to_string(i));
+    }
+}
+
+TEST_CASE("Literals carry their decoded values", "[lexer][literals]") {
+    Lexer::Lexer lexer("123 45.67 true false 0 9223372036854775807 0.5", false);
+    auto tokens = lexer.Tokenize();
+
+    REQUIRE(tokens[0].type == Lexer::TokenType::INT_LITERAL);
+    REQUIRE(tokens[0].IntValue() == 123);
+    REQUIRE(tokens[1].type == Lexer::TokenType::FLOAT_LITERAL);
+    REQUIRE(tokens[1].FloatValue() == 45.67);
+    REQUIRE(tokens[2].BoolValue());
+    REQUIRE_FALSE(tokens[3].BoolValue());
+    REQUIRE(tokens[4].IntValue() == 0);
+    REQUIRE(tokens[5].IntValue() == 9223372036854775807);
+    REQUIRE(tokens[6].FloatValue() == 0.5);
+    REQUIRE(lexer.Diagnostics().empty());
+
+    Lexer::Lexer streamed("7 2.25", false);
+    const Lexer::TokenStream stream = streamed.TokenizeStream();
+    REQUIRE(stream[0].IntValue() == 7);
+    REQUIRE(stream[1].FloatValue() == 2.25);
+}
+
+TEST_CASE("Lexer reports overflowing literals", "[lexer][literals][error]") {
+    std::string input = "1 9223372036854775808 2 " + std::string(400, '9') + ".5";
+    Lexer::Lexer lexer(input, false);
+    auto tokens = lexer.Tokenize();
+
+    REQUIRE(tokens[1].type == Lexer::TokenType::INT_LITERAL);
+    REQUIRE(tokens[3].type == Lexer::TokenType::FLOAT_LITERAL);
+
+    const auto& diagnostics = lexer.Diagnostics();
+    REQUIRE(diagnostics.size() == 2);
+    REQUIRE(diagnostics[0].kind == Lexer::DiagnosticKind::INTEGER_OVERFLOW);
+    REQUIRE(diagnostics[0].offset == tokens[1].offset);
+    REQUIRE(diagnostics[0].length == 19);
+    REQUIRE(diagnostics[1].kind == Lexer::DiagnosticKind::FLOAT_OUT_OF_RANGE);
+    REQUIRE(diagnostics[1].offset == tokens[3].offset);
+
+    Lexer::ThreadPool pool(2);
+    Lexer::ParallelLexer parallel(input + " \"99999999999999999999\"", false, 7);
+    parallel.Tokenize(pool);
+    REQUIRE(parallel.Diagnostics().size() == 2);
+    REQUIRE(parallel.Diagnostics()[0].offset == diagnostics[0].offset);
+    REQUIRE(parallel.Diagnostics()[1].offset == diagnostics[1].offset);
+}
+
+TEST_CASE("Lexer decodes escapes in string literals", "[lexer][string]") {
+    std::string input = R"("plain" "a\"b" "tab\there\n" "back\\slash" "\u{48}\u{e9}\u{20AC}\u{1F600}" ")" +
+                        std::string(300, 'x') + R"(\")" + std::string(300, 'y') + "\"";
+    Lexer::Lexer lexer(input, false);
+    auto tokens = lexer.Tokenize();
+
+    REQUIRE(tokens.size() == 7);
+    for (size_t i = 0; i < 6; ++i) {
+        REQUIRE(tokens[i].type == Lexer::TokenType::STRING_LITERAL);
+    }
+    REQUIRE(tokens[0].lexeme == "plain");
+    REQUIRE(tokens[1].lexeme == "a\"b");
+    REQUIRE(tokens[2].lexeme == "tab\there\n");
+    REQUIRE(tokens[3].lexeme == "back\\slash");
+    REQUIRE(tokens[4].lexeme == "H\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80");
+    REQUIRE(tokens[5].lexeme == std::string(300, 'x') + "\"" + std::string(300, 'y'));
+    REQUIRE(lexer.Diagnostics().empty());
+
+    // Literals without escapes are views into the source; only escaped ones are copied out.
+    const char* source = tokens[0].lexeme.data() - 1;
+    REQUIRE(tokens[5].lexeme.data() != source + tokens[5].offset + 1);
+    Lexer::Lexer unescaped(R"("abc" "de")", false);
+    auto views = unescaped.Tokenize();
+    REQUIRE(views[1].lexeme.data() == views[0].lexeme.data() + 6);
+}
+
+TEST_CASE("Lexer reports bad escapes and unterminated strings", "[lexer][string][error]") {
+    std::string input = R"("a\qb" "\u{D800}" "\u{110000}" "\u{zz}" "\u12" "end\")";
+    Lexer::Lexer lexer(input, false);
+    auto tokens = lexer.Tokenize();
+
+    REQUIRE(tokens[0].lexeme == "a\\qb");
+    REQUIRE(tokens[1].lexeme == "\\u{D800}");
+    REQUIRE(tokens[2].lexeme == "\\u{110000}");
+    REQUIRE(tokens[3].lexeme == "\\u{zz}");
+    REQUIRE(tokens[4].lexeme == "\\u12");
+    REQUIRE(tokens[5].type == Lexer::TokenType::UNKNOWN);
+
+    const auto& diagnostics = lexer.Diagnostics();
+    REQUIRE(diagnostics.size() == 6);
+    REQUIRE(diagnostics[0].kind == Lexer::DiagnosticKind::INVALID_ESCAPE);
+    REQUIRE(diagnostics[0].offset == 2);
+    REQUIRE(diagnostics[0].length == 2);
+    for (size_t i = 1; i < 5; ++i) {
+        REQUIRE(diagnostics[i].kind == Lexer::DiagnosticKind::INVALID_ESCAPE);
+        REQUIRE(diagnostics[i].offset == tokens[i].offset + 1);
+    }
+    REQUIRE(diagnostics[5].kind == Lexer::DiagnosticKind::UNTERMINATED_STRING);
+    REQUIRE(diagnostics[5].offset == tokens[5].offset);
+}
+
+TEST_CASE("Lexer can keep tokens and lexemes in a caller's arena", "[lexer][arena]") {
+    std::string input;
+    for (int i = 0; i < 2000; ++i) {
+        input += "var x" + std::to_string(i) + " = \"line\\t" + std::to_string(i) + "\" + " + std::to_string(i) + ";\n";
+    }
+
+    Lexer::Lexer reference(input, false);
+    const auto expected = reference.Tokenize();
+
+    Lexer::Arena arena;
+    {
+        Lexer::Lexer lexer(input, false, &arena);
+        const std::pmr::vector<Lexer::Token> tokens = lexer.Tokenize(&arena);
+
+        REQUIRE(tokens.get_allocator().resource() == &arena);
+        REQUIRE(tokens.size() == expected.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            REQUIRE(tokens[i].type == expected[i].type);
+            REQUIRE(tokens[i].lexeme == expected[i].lexeme);
+            REQUIRE(tokens[i].offset == expected[i].offset);
+        }
+        REQUIRE(tokens[3].lexeme == "line\t0");
+        REQUIRE(arena.BytesReserved() >= tokens.size() * sizeof(Lexer::Token));
+    }
+
+    arena.Release();
+    REQUIRE(arena.BytesReserved() == 0);
+
+    // Sparse source: the vector is sized from the tokens actually there, not one per four bytes.
+    std::string sparse;
+    for (int i = 0; i < 2000; ++i) {
+        sparse += "x" + std::to_string(i) + " = 1; // " + std::string(100, 'c') + "\n";
+    }
+    {
+        Lexer::Lexer lexer(sparse, false, &arena);
+        const std::pmr::vector<Lexer::Token> tokens = lexer.Tokenize(&arena);
+        REQUIRE(tokens.size() == 4 * 2000 + 1);
+        REQUIRE(arena.BytesReserved() < 2 * tokens.size() * sizeof(Lexer::Token));
+    }
+}
+
+TEST_CASE("Lexer can be reset and re-run without allocating", "[lexer][reset]") {
+    const std::vector<std::string> scripts = {
+        "var a = 1 + 2;",
+        "function f(x: int) -> int { return x * \"\\t\"; }",
+        "if (a == b) { c = 12.5; } else { d = \"text\"; }",
+    };
+
+    // Tokenize starts over from the beginning each time instead of returning only what is left.
+    Lexer::Lexer lexer("var x = 1;", false);
+    const auto first = lexer.Tokenize();
+    const auto second = lexer.Tokenize();
+    REQUIRE(second.size() == first.size());
+    REQUIRE(std::count_if(second.begin(), second.end(), [](const Lexer::Token& token) {
+        return token.type == Lexer::TokenType::END_OF_FILE;
+    }) == 1);
+
+    std::vector<Lexer::Token> tokens;
+    for (const std::string& script : scripts) {
+        lexer.Reset(script);
+        lexer.Tokenize(tokens);
+
+        Lexer::Lexer fresh(script, false);
+        const auto expected = fresh.Tokenize();
+        REQUIRE(tokens.size() == expected.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            REQUIRE(tokens[i].type == expected[i].type);
+            REQUIRE(tokens[i].lexeme == expected[i].lexeme);
+        }
+    }
+
+    // Everything has grown to fit by now, so another round should not touch the heap at all.
+    const std::size_t before = allocationCount;
+    for (const std::string& script : scripts) {
+        lexer.Reset(script);
+        lexer.Tokenize(tokens);
+    }
+    REQUIRE(allocationCount == before);
+    REQUIRE(tokens.back().type == Lexer::TokenType::END_OF_FILE);
+}
+
+TEST_CASE("Thread pool tasks can wait on tasks they submit", "[lexer][threadpool]") {
+    Lexer::ThreadPool pool(2);
+
+    // Every worker blocks in Wait at once, which would deadlock if waiting did not run other tasks.
+    std::vector<std::future<int>> outer;
+    for (int i = 0; i < 8; ++i) {
+        outer.push_back(pool.Submit([&pool, i] {
+            std::vector<std::future<int>> inner;
+            for (int j = 0; j < 16; ++j) {
+                inner.push_back(pool.Submit([i, j] { return i * j; }));
+            }
+            int sum = 0;
+            for (auto& result : inner) sum += pool.Wait(result);
+            return sum;
+        }));
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        REQUIRE(pool.Wait(outer[i]) == i * 120);
+    }
+}
+
+TEST_CASE("Thread pool WaitAll finishes every task before rethrowing", "[lexer][threadpool]") {
+    Lexer::ThreadPool pool(2);
+
+    std::atomic<int> finished = 0;
+    std::vector<std::future<void>> tasks;
+    tasks.push_back(pool.Submit([] { throw std::runtime_error("first"); }));
+    for (int i = 0; i < 32; ++i) {
+        tasks.push_back(pool.Submit([&finished] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            finished++;
+        }));
+    }
+
+    REQUIRE_THROWS_WITH(pool.WaitAll(tasks), "first");
+    REQUIRE(finished == 32);
+}
+
+TEST_CASE("Batch lexer returns every file's tokens in input order", "[lexer][batch]") {
+    std::vector<std::string> sources;
+    for (int i = 0; i < 40; ++i) {
+        std::string source;
+        for (int j = 0; j < (i % 7) * 50 + 1; ++j) {
+            source += "var v" + std::to_string(j) + " = \"s\\t" + std::to_string(i) + "\" + " + std::to_string(j) + ";\n";
+        }
+        sources.push_back(source + (i % 5 == 0 ? "99999999999999999999" : ""));
+    }
+    // Well past the split size, so it goes through the parallel lexer.
+    std::string huge;
+    for (int i = 0; i < 3000; ++i) huge += "if (x" + std::to_string(i) + " >= 10) { y = \"a\\qb\"; }\n";
+    sources.insert(sources.begin() + 3, huge);
+
+    const std::vector<std::string_view> buffers(sources.begin(), sources.end());
+    Lexer::ThreadPool pool(4);
+    Lexer::BatchLexer batch(pool, 4096);
+    const auto files = batch.LexBuffers(buffers);
+
+    REQUIRE(files.size() == sources.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        INFO("File " << i);
+        Lexer::Lexer sequential(sources[i], false);
+        const auto expected = sequential.Tokenize();
+
+        REQUIRE_FALSE(files[i].error);
+        REQUIRE(files[i].tokens.Size() == expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            REQUIRE(files[i].tokens.Type(j) == expected[j].type);
+            REQUIRE(files[i].tokens.Lexeme(j) == expected[j].lexeme);
+        }
+        REQUIRE(files[i].diagnostics.size() == sequential.Diagnostics().size());
+    }
+
+    const TemporaryFile file("vireo_batch_test_source.vireo", "var x: int = 10;\n");
+    const auto loaded = batch.LexFiles({"this/file/does/not/exist.vireo", file.Path()});
+
+    REQUIRE(loaded[0].error);
+    REQUIRE_THROWS_AS(std::rethrow_exception(loaded[0].error), std::system_error);
+    REQUIRE_FALSE(loaded[1].error);
+    REQUIRE(loaded[1].tokens.Size() == 8);
+    REQUIRE(loaded[1].tokens.Lexeme(5) == "10");
+}
+
+TEST_CASE("Lexer accepts Unicode identifiers and validates UTF-8", "[lexer][unicode]") {
+    std::string input = "var gr\xC3\xB6\xC3\x9F" "e = \"h\xC3\xA9llo\"; \xE5\xA4\x89\xE6\x95\xB0 caf\xC3\xA9_1 \xE2\x82\xAC "
+                        "\xFF\xFE x \"a\xC3(b\" \xCF\x80";
+    Lexer::Lexer lexer(input, false);
+    auto tokens = lexer.Tokenize();
+
+    REQUIRE(tokens.size() == 13);
+    REQUIRE(tokens[1].type == Lexer::TokenType::IDENTIFIER);
+    REQUIRE(tokens[1].lexeme == "gr\xC3\xB6\xC3\x9F" "e");
+    REQUIRE(tokens[3].type == Lexer::TokenType::STRING_LITERAL);
+    REQUIRE(tokens[3].lexeme == "h\xC3\xA9llo");
+    REQUIRE(tokens[5].type == Lexer::TokenType::IDENTIFIER);
+    REQUIRE(tokens[5].lexeme == "\xE5\xA4\x89\xE6\x95\xB0");
+    REQUIRE(tokens[6].lexeme == "caf\xC3\xA9_1");
+    REQUIRE(Lexer::Interner::Global().Spelling(tokens[6].Symbol()) == "caf\xC3\xA9_1");
+
+    // A symbol that cannot start an identifier is one token, not one per byte, and so is a run of bad bytes.
+    REQUIRE(tokens[7].type == Lexer::TokenType::UNKNOWN);
+    REQUIRE(tokens[7].lexeme == "\xE2\x82\xAC");
+    REQUIRE(tokens[8].type == Lexer::TokenType::UNKNOWN);
+    REQUIRE(tokens[8].lexeme == "\xFF\xFE");
+    REQUIRE(tokens[9].lexeme == "x");
+    REQUIRE(tokens[10].type == Lexer::TokenType::STRING_LITERAL);
+    REQUIRE(tokens[11].type == Lexer::TokenType::IDENTIFIER);
+
+    const auto& diagnostics = lexer.Diagnostics();
+    REQUIRE(diagnostics.size() == 2);
+    REQUIRE(diagnostics[0].kind == Lexer::DiagnosticKind::INVALID_UTF8);
+    REQUIRE(diagnostics[0].offset == tokens[8].offset);
+    REQUIRE(diagnostics[0].length == 2);
+    REQUIRE(diagnostics[1].kind == Lexer::DiagnosticKind::INVALID_UTF8);
+    REQUIRE(diagnostics[1].offset == tokens[10].offset + 2);
+    REQUIRE(diagnostics[1].token == tokens[10].offset);
+
+    std::uint32_t codePoint = 0;
+    REQUIRE(Lexer::DecodeUtf8("\xC0\xAF", 0, codePoint) == 0); // Overlong.
+    REQUIRE(Lexer::DecodeUtf8("\xED\xA0\x80", 0, codePoint) == 0); // Surrogate.
+    REQUIRE(Lexer::DecodeUtf8("\xF4\x90\x80\x80", 0, codePoint) == 0); // Past U+10FFFF.
+    REQUIRE(Lexer::DecodeUtf8("\xF0\x9F\x98\x80", 0, codePoint) == 4);
+    REQUIRE(codePoint == 0x1F600);
+    static_assert(Lexer::IsXidStart(0x3C0) && !Lexer::IsXidStart(0x20AC) && Lexer::IsXidContinue(0x0301));
+}
+
+TEST_CASE("UTF-8 validation kernels agree", "[lexer][unicode][simd]") {
+    // Valid pieces first, including the edges of each range, then one of each kind of error.
+    const std::vector<std::string> valid = {
+        "plain ascii text ", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xC2\x80", "\xDF\xBF", "\xE0\xA0\x80",
+        "\xED\x9F\xBF", "\xEE\x80\x80", "\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF"
+    };
+    const std::vector<std::string> invalid = {
+        "\xFF", "\xC3", "\x80", "\xED\xA0\x80", "\xC0\xAF", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF",
+        "\xF0\x80\x80\x80", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xF8\x88\x80\x80\x80",
+        "\xE2\x82", "\xF0\x9F\x98", "\xC3\xA9\xA9", "\xE2\x82\xAC\x80", "\xF0\x9F\x98\x80\x80"
+    };
+    std::mt19937 random(17);
+    std::string input;
+    for (int i = 0; i < 3000; ++i) {
+        input += i % 2 == 0 ? valid[0] : valid[random() % valid.size()];
+        if (i % 23 == 22) input += invalid[random() % invalid.size()];
+    }
+    input += "\xF0\x9F"; // Cut off at the very end.
+
+    const Lexer::ScanKernel original = Lexer::ActiveScanKernel();
+    std::vector<std::vector<std::size_t>> results;
+    for (const auto kernel : {Lexer::ScanKernel::SCALAR, Lexer::ScanKernel::SSE2, Lexer::ScanKernel::AVX2}) {
+        if (!Lexer::ForceScanKernel(kernel)) continue;
+
+        std::vector<std::size_t>& found = results.emplace_back();
+        for (std::size_t position = Lexer::FindInvalidUtf8(input, 0); position < input.size();
+             position = Lexer::FindInvalidUtf8(input, position + 1)) {
+            found.push_back(position);
+        }
+        // Starting anywhere, even partway through a sequence, gives the same answer as decoding from there.
+        for (std::size_t start = 0; start < input.size(); start += 7) {
+            found.push_back(Lexer::FindInvalidUtf8(input, start));
+        }
+    }
+    Lexer::ForceScanKernel(original);
+
+    REQUIRE(results[0].size() >= 3000 / 23);
+    for (const auto& found : results) {
+        REQUIRE(found == results[0]);
+    }
+}
+
+TEST_CASE("Lexer skips comments or keeps them as trivia", "[lexer][comment]") {
+    std::string input = "a / b // line comment / * \"x\"\n"
+                        "/* block\n comment ** / */ c /**/ d // no newline";
+    Lexer::Lexer lexer(input, false);
+    auto tokens = lexer.Tokenize();
+
+    REQUIRE(tokens.size() == 6);
+    REQUIRE(tokens[1].type == Lexer::TokenType::DIV);
+    REQUIRE(tokens[3].lexeme == "c");
+    REQUIRE(tokens[4].lexeme == "d");
+    REQUIRE(lexer.Locate(tokens[3]).line == 3);
+    REQUIRE(lexer.Diagnostics().empty());
+
+    lexer.KeepComments(true);
+    auto trivia = lexer.Tokenize();
+    REQUIRE(trivia.size() == 10);
+    REQUIRE(trivia[3].type == Lexer::TokenType::COMMENT);
+    REQUIRE(trivia[3].lexeme == "// line comment / * \"x\"");
+    REQUIRE(trivia[4].lexeme == "/* block\n comment ** / */");
+    REQUIRE(trivia[6].lexeme == "/**/");
+    REQUIRE(trivia[8].lexeme == "// no newline");
+
+    Lexer::Lexer unterminated("x /* never closed", false);
+    auto open = unterminated.Tokenize();
+    REQUIRE(open.size() == 3);
+    REQUIRE(open[1].type == Lexer::TokenType::UNKNOWN);
+    REQUIRE(unterminated.Diagnostics().size() == 1);
+    REQUIRE(unterminated.Diagnostics()[0].kind == Lexer::DiagnosticKind::UNTERMINATED_COMMENT);
+    REQUIRE(unterminated.Diagnostics()[0].offset == 2);
+
+    // Comment text is validated when it becomes a token, and only then.
+    const std::string invalid = "a // bad \xff\n/* bad \xc3 */ b /* open \xfe";
+    Lexer::Lexer skipped(invalid, false);
+    skipped.Tokenize();
+    REQUIRE(skipped.Diagnostics().size() == 2);
+    REQUIRE(skipped.Diagnostics()[0].kind == Lexer::DiagnosticKind::INVALID_UTF8);
+    REQUIRE(skipped.Diagnostics()[0].offset == invalid.find('\xfe'));
+    REQUIRE(skipped.Diagnostics()[1].kind == Lexer::DiagnosticKind::UNTERMINATED_COMMENT);
+
+    Lexer::Lexer kept(invalid, false);
+    kept.KeepComments(true);
+    const auto keptTokens = kept.Tokenize();
+    REQUIRE(kept.Diagnostics().size() == 4);
+    REQUIRE(kept.Diagnostics()[0].offset == invalid.find('\xff'));
+    REQUIRE(kept.Diagnostics()[0].token == keptTokens[1].offset);
+    REQUIRE(kept.Diagnostics()[1].offset == invalid.find('\xc3'));
+    REQUIRE(kept.Diagnostics()[1].token == keptTokens[2].offset);
+    REQUIRE(kept.Diagnostics()[2].offset == invalid.find('\xfe'));
+}
+
+TEST_CASE("Token cache returns stored streams and ignores bad entries", "[lexer][cache]") {
+    namespace fs = std::filesystem;
+    const fs::path directory = fs::temp_directory_path() / "vireo_token_cache_test";
+    fs::remove_all(directory);
+    Lexer::TokenCache cache(directory);
+
+    const std::string input = "var name = \"tab\\there\"; // note\nreturn name + 99999999999999999999 * other;";
+    Lexer::Lexer plain(input, false);
+    const auto expected = plain.Tokenize();
+
+    Lexer::Lexer first(input, false);
+    first.UseCache(&cache);
+    const auto missed = first.Tokenize();
+    REQUIRE(std::distance(fs::directory_iterator(directory), fs::directory_iterator()) == 1);
+
+    Lexer::Lexer second(input, false);
+    second.UseCache(&cache);
+    const auto hit = second.Tokenize();
+    const Lexer::TokenStream stream = second.TokenizeStream();
+
+    for (const auto* tokens : {&missed, &hit}) {
+        REQUIRE(tokens->size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            REQUIRE((*tokens)[i].type == expected[i].type);
+            REQUIRE((*tokens)[i].lexeme == expected[i].lexeme);
+            REQUIRE((*tokens)[i].offset == expected[i].offset);
+            REQUIRE((*tokens)[i].payload == expected[i].payload);
+        }
+    }
+    REQUIRE(stream.Size() == expected.size());
+    REQUIRE(stream.Lexeme(3) == "tab\there");
+    REQUIRE(stream.Symbol(1) == expected[1].Symbol());
+    REQUIRE(second.Diagnostics().size() == 1);
+    REQUIRE(second.Diagnostics()[0].kind == Lexer::DiagnosticKind::INTEGER_OVERFLOW);
+
+    // Keeping comments changes the tokens, so it must not share an entry with the default.
+    Lexer::Lexer trivia(input, false);
+    trivia.KeepComments(true);
+    trivia.UseCache(&cache);
+    REQUIRE(trivia.Tokenize().size() == expected.size() + 1);
+
+    // A loaded stream views the entry; editing it copies the arrays out with identifiers resolved.
+    Lexer::TokenStream edited = stream;
+    edited.Splice(0, stream.Size(), stream);
+    edited.ShiftOffsets(0, 0);
+    REQUIRE(edited.Size() == expected.size());
+    REQUIRE(edited.Symbol(1) == expected[1].Symbol());
+    REQUIRE(edited[3].lexeme == "tab\there");
+
+    // Flip a byte in every entry: with verification on, each is then ignored and rewritten rather than trusted.
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        std::fstream file(entry.path(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(-1, std::ios::end);
+        const char last = static_cast<char>(file.get());
+        file.seekp(-1, std::ios::end);
+        file.put(static_cast<char>(last ^ 0x5A));
+    }
+    Lexer::TokenCache verifying(directory, true);
+    Lexer::TokenStream loaded;
+    std::vector<Lexer::Diagnostic> diagnostics;
+    REQUIRE_FALSE(verifying.Load(input, 0, loaded, diagnostics));
+
+    Lexer::Lexer third(input, false);
+    third.UseCache(&verifying);
+    REQUIRE(third.Tokenize().size() == expected.size());
+    REQUIRE(verifying.Load(input, 0, loaded, diagnostics));
+    REQUIRE_FALSE(cache.Load(input + " ", 0, loaded, diagnostics));
+
+    // A truncated entry is caught by its size even without verification.
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        fs::resize_file(entry.path(), fs::file_size(entry.path()) - 1);
+    }
+    REQUIRE_FALSE(cache.Load(input, 0, loaded, diagnostics));
+
+    fs::remove_all(directory);
+}
+
+TEST_CASE("SPSC ring hands items across threads in order", "[lexer][pipeline]") {
+    Lexer::SpscRing<int> ring(6);
+    REQUIRE(ring.Capacity() == 8);
+
+    constexpr int count = 200000;
+    std::thread producer([&] {
+        for (int i = 0; i < count; ++i) {
+            int value = i;
+            while (!ring.TryPush(value)) ring.WaitForSpace();
+        }
+    });
+
+    bool ordered = true;
+    for (int i = 0; i < count; ++i) {
+        int value = -1;
+        while (!ring.TryPop(value)) ring.WaitForItems();
+        ordered = ordered && value == i;
+    }
+    producer.join();
+
+    int leftover;
+    REQUIRE(ordered);
+    REQUIRE_FALSE(ring.TryPop(leftover));
+}
+
+TEST_CASE("Pipelined lexer streams the same tokens in batches", "[lexer][pipeline]") {
+    std::string source;
+    for (int i = 0; i < 2000; ++i) {
+        source += "if (x" + std::to_string(i) + " >= 10) { y = \"a\\tb\"; } // " + std::to_string(i) + "\n";
+    }
+    Lexer::Lexer sequential(source, false);
+    const auto expected = sequential.Tokenize();
+
+    Lexer::Lexer lexer(source, false);
+    std::vector<Lexer::Token> streamed;
+    {
+        Lexer::PipelinedLexer pipeline(lexer, 100, 2);
+        size_t batches = 0;
+        for (auto batch = pipeline.NextBatch(); !batch.empty(); batch = pipeline.NextBatch()) {
+            REQUIRE(batch.size() <= 100);
+            streamed.insert(streamed.end(), batch.begin(), batch.end());
+            ++batches;
+        }
+        REQUIRE(batches == (expected.size() + 99) / 100);
+        REQUIRE(pipeline.NextBatch().empty());
+    }
+
+    REQUIRE(streamed.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        REQUIRE(streamed[i].type == expected[i].type);
+        REQUIRE(streamed[i].offset == expected[i].offset);
+        REQUIRE(streamed[i].lexeme == expected[i].lexeme);
+    }
+    REQUIRE(lexer.Diagnostics().size() == sequential.Diagnostics().size());
+
+    // A consumer that gives up early must not leave the lexer thread waiting for room.
+    Lexer::Lexer abandoned(source, false);
+    {
+        Lexer::PipelinedLexer pipeline(abandoned, 16, 1);
+        REQUIRE(pipeline.NextBatch().size() == 16);
+    }
+}
+
+TEST_CASE("Perf counters charge phases or report why they cannot", "[lexer][perf]") {
+    Lexer::PerfCounters counters;
+    std::ostringstream report;
+
+    if (!counters.Available()) {
+        REQUIRE(Lexer::PerfCounters::Current() == nullptr);
+        counters.Report(report, 0);
+        REQUIRE(report.str().find("unavailable") != std::string::npos);
+        return;
+    }
+
+    REQUIRE(Lexer::PerfCounters::Current() == &counters);
+    {
+        const Lexer::PerfScope scan(Lexer::PerfPhase::SCAN);
+        Lexer::Lexer lexer(std::string(10000, 'x') + " 1 2 3", false);
+        REQUIRE(lexer.Tokenize().size() == 5);
+        {
+            const Lexer::PerfScope emit(Lexer::PerfPhase::EMIT);
+            volatile int sink = 0;
+            for (int i = 0; i < 1000; ++i) sink = sink + i;
+        }
+    }
+
+    REQUIRE(counters.Count(Lexer::PerfPhase::SCAN, Lexer::PerfEvent::INSTRUCTIONS) > 0);
+    REQUIRE(counters.Count(Lexer::PerfPhase::EMIT, Lexer::PerfEvent::INSTRUCTIONS) > 0);
+    REQUIRE(counters.Count(Lexer::PerfPhase::LOAD, Lexer::PerfEvent::INSTRUCTIONS) == 0);
+    counters.Report(report, 1 << 20);
+    REQUIRE(report.str().find("per MB") != std::string::npos);
+}
+
+TEST_CASE("Time trace records per-file spans as trace-event JSON", "[lexer][trace]") {
+    Lexer::ThreadPool pool(2);
+    Lexer::BatchLexer batch(pool);
+    const std::vector<std::string_view> buffers = {"var x = 1;", "if (y) { z = \"w\"; }"};
+
+    // Nothing is recorded while no trace is active.
+    batch.LexBuffers(buffers);
+    REQUIRE(Lexer::TimeTrace::Active() == nullptr);
+
+    std::ostringstream json;
+    std::string path;
+    {
+        Lexer::TimeTrace trace;
+        REQUIRE(Lexer::TimeTrace::Active() == &trace);
+
+        const TemporaryFile file("vireo \"trace\" test.vireo", "var x: int = 10;\n");
+        batch.LexFiles({file.Path()});
+        batch.LexBuffers(buffers);
+        path = file.Path();
+
+        REQUIRE(trace.Size() == 6);
+        trace.Write(json);
+    }
+    REQUIRE(Lexer::TimeTrace::Active() == nullptr);
+
+    const std::string text = json.str();
+    const auto count = [&](const std::string& needle) {
+        size_t found = 0;
+        for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) ++found;
+        return found;
+    };
+    REQUIRE(text.starts_with("{\"traceEvents\":["));
+    REQUIRE(count("\"name\":\"Load\"") == 3);
+    REQUIRE(count("\"name\":\"Lex\"") == 3);
+    REQUIRE(count("\"ph\":\"X\"") == 6);
+    std::string escaped;
+    for (const char c : path) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    REQUIRE(escaped.ends_with("vireo \\\"trace\\\" test.vireo"));
+    REQUIRE(count("\"detail\":\"" + escaped + "\"") == 2);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("Stream lexer matches Tokenize across block boundaries", "[lexer][stream]") {
+    std::string source;
+    for (int i = 0; i < 300; ++i) {
+        source += "var name" + std::to_string(i) + " = 3.25 + \"a\\tb\\q\" -> x == 12345; // c\n/* block */ é" +
+            std::to_string(i) + " ";
+    }
+    source += 'x' + std::string(500, 'y') + " \"unterminated";
+
+    Lexer::Lexer whole(source, false);
+    const auto expected = whole.Tokenize();
+
+    for (const std::size_t blockSize : {1, 7, 64, 4096}) {
+        INFO("Block size " << blockSize);
+        int pipeFds[2];
+        REQUIRE(pipe(pipeFds) == 0);
+
+        // Odd write sizes, so reads return short and uneven blocks.
+        std::thread writer([&] {
+            for (size_t at = 0; at < source.size();) {
+                const size_t count = std::min<size_t>(source.size() - at, 1 + at % 97);
+                const ssize_t written = write(pipeFds[1], source.data() + at, count);
+                if (written <= 0) break;
+                at += static_cast<size_t>(written);
+            }
+            close(pipeFds[1]);
+        });
+
+        Lexer::StreamLexer stream(pipeFds[0], blockSize);
+        bool matches = true;
+        size_t count = 0;
+        while (true) {
+            const Lexer::Token token = stream.NextToken();
+            matches = matches && count < expected.size() && token.type == expected[count].type &&
+                token.offset == expected[count].offset && token.lexeme == expected[count].lexeme;
+            ++count;
+            if (token.type == Lexer::TokenType::END_OF_FILE) break;
+        }
+        writer.join();
+        close(pipeFds[0]);
+
+        REQUIRE(matches);
+        REQUIRE(count == expected.size());
+        REQUIRE(stream.Diagnostics().size() == whole.Diagnostics().size());
+        for (size_t i = 0; i < whole.Diagnostics().size(); ++i) {
+            REQUIRE(stream.Diagnostics()[i].offset == whole.Diagnostics()[i].offset);
+            REQUIRE(stream.Diagnostics()[i].kind == whole.Diagnostics()[i].kind);
+        }
+        // Only the 500-byte identifier and the unterminated string make the window grow.
+        REQUIRE(stream.WindowSize() <= std::max<size_t>(4 * blockSize, 2048));
+    }
+}
+
+TEST_CASE("Stream lexer keeps comments longer than a block whole", "[lexer][stream]") {
+    std::string source;
+    for (int i = 0; i < 40; ++i) {
+        source += "a" + std::to_string(i) + " // " + std::string(90, 'c') + " b; \"c\" /* d\n*/\n";
+        source += "/* " + std::string(70, '*') + " x = 1; // y\n " + std::string(30, '/') + " */ b" +
+            std::to_string(i) + " = 2;\n";
+    }
+    source += "z /* unterminated " + std::string(200, 'u');
+
+    for (const bool keepComments : {false, true}) {
+        Lexer::Lexer whole(source, false);
+        whole.KeepComments(keepComments);
+        const auto expected = whole.Tokenize();
+
+        for (const std::size_t blockSize : {1, 8, 16, 64}) {
+            INFO("Block size " << blockSize << ", keep comments " << keepComments);
+            int pipeFds[2];
+            REQUIRE(pipe(pipeFds) == 0);
+
+            std::thread writer([&] {
+                for (size_t at = 0; at < source.size();) {
+                    const size_t count = std::min<size_t>(source.size() - at, 1 + at % 13);
+                    const ssize_t written = write(pipeFds[1], source.data() + at, count);
+                    if (written <= 0) break;
+                    at += static_cast<size_t>(written);
+                }
+                close(pipeFds[1]);
+            });
+
+            Lexer::StreamLexer stream(pipeFds[0], blockSize);
+            stream.KeepComments(keepComments);
+            bool matches = true;
+            size_t count = 0;
+            while (true) {
+                const Lexer::Token token = stream.NextToken();
+                matches = matches && count < expected.size() && token.type == expected[count].type &&
+                    token.offset == expected[count].offset && token.lexeme == expected[count].lexeme;
+                ++count;
+                if (token.type == Lexer::TokenType::END_OF_FILE) break;
+            }
+            writer.join();
+            close(pipeFds[0]);
+
+            REQUIRE(matches);
+            REQUIRE(count == expected.size());
+            REQUIRE(stream.Diagnostics().size() == whole.Diagnostics().size());
+            for (size_t i = 0; i < whole.Diagnostics().size(); ++i) {
+                REQUIRE(stream.Diagnostics()[i].offset == whole.Diagnostics()[i].offset);
+                REQUIRE(stream.Diagnostics()[i].kind == whole.Diagnostics()[i].kind);
+            }
+        }
+    }
+}
+
+TEST_CASE("Stream lexer rescans a long token a logarithmic number of times", "[lexer][stream]") {
+    const std::string payload(1 << 20, 'j');
+    const std::string source = "var json = \"" + payload + "\";";
+
+    int pipeFds[2];
+    REQUIRE(pipe(pipeFds) == 0);
+
+    // Small writes, so each read returns far less than the token.
+    std::thread writer([&] {
+        for (size_t at = 0; at < source.size();) {
+            const ssize_t written = write(pipeFds[1], source.data() + at, std::min<size_t>(source.size() - at, 1000));
+            if (written <= 0) break;
+            at += static_cast<size_t>(written);
+        }
+        close(pipeFds[1]);
+    });
+
+    Lexer::StreamLexer stream(pipeFds[0], 64);
+    std::vector<Lexer::TokenType> types;
+    std::string literal;
+    while (true) {
+        const Lexer::Token token = stream.NextToken();
+        types.push_back(token.type);
+        if (token.type == Lexer::TokenType::STRING_LITERAL) literal = token.lexeme;
+        if (token.type == Lexer::TokenType::END_OF_FILE) break;
+    }
+    writer.join();
+    close(pipeFds[0]);
+
+    REQUIRE(types.size() == 6);
+    REQUIRE(literal == payload);
+    // One refill per doubling of the token, not one per read.
+    REQUIRE(stream.Refills() <= 40);
+    REQUIRE(stream.WindowSize() <= 4 * source.size());
+}
+#endif
+
+TEST_CASE("Scripts lex at compile time to the same tokens as at run time", "[lexer][consteval]") {
+    static constexpr auto prelude = Lexer::TokenizeConstant<
+        "function area(r: float) -> float { return 3.14159 * r * r; }\n"
+        "var greeting: string = \"h\\u{e9}llo\\n\\t\\\"w\\\"\"; // kept?\n"
+        "if (x >= 9223372036854775807 && ok == true) { n = 0.5; } /* block */ λ1 = \"\";">();
+    static_assert(prelude.Size() > 40);
+    static_assert(prelude[0].type == Lexer::TokenType::FUNCTION);
+    static_assert(prelude[prelude.Size() - 1].type == Lexer::TokenType::END_OF_FILE);
+
+    static constexpr auto withComments = Lexer::TokenizeConstant<"a // note\n/* b */", true>();
+    static_assert(withComments.Size() == 4 && withComments[1].type == Lexer::TokenType::COMMENT);
+
+    Lexer::Lexer lexer(std::string(prelude.source), false);
+    const auto expected = lexer.Tokenize();
+    REQUIRE(lexer.Diagnostics().empty());
+
+    REQUIRE(prelude.Size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        INFO("Token " << i << " '" << expected[i].lexeme << "'");
+        REQUIRE(prelude[i].type == expected[i].type);
+        REQUIRE(prelude[i].offset == expected[i].offset);
+        REQUIRE(prelude[i].lexeme == expected[i].lexeme);
+        // Only identifiers differ: their symbols come from the interner at run time.
+        if (expected[i].type != Lexer::TokenType::IDENTIFIER) {
+            REQUIRE(prelude[i].payload == expected[i].payload);
+        }
+    }
+    REQUIRE(prelude[prelude.Size() - 3].type == Lexer::TokenType::STRING_LITERAL);
+    REQUIRE(prelude[prelude.Size() - 3].lexeme.empty());
+    REQUIRE(prelude[23].lexeme == "h\xc3\xa9llo\n\t\"w\"");
+}